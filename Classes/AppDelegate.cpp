@@ -24,9 +24,12 @@
 
 #include "AppDelegate.h"
 #include "BandInput.h"
+#include "BandLatency.h"
 #include "HelloWorldScene.h"
+#include "BandView.h"
 #include "SequenceGame.h"
 
+#include <cstdlib>
 #include <iostream>
 
 // #define USE_AUDIO_ENGINE 1
@@ -84,20 +87,18 @@ static int register_all_packages()
 
 static void onMouseEvent(EventMouse *event, EventMouse::MouseEventType evtype)
 {
-	Node *node = event->getCurrentTarget();
-	if (!node)
+	auto *view = static_cast<BandView *>(event->getCurrentTarget());
+	if (!view)
 		return;
 
 	auto pt = event->getLocation();
 	pt.y = Director::getInstance()->getOpenGLView()->getFrameSize().height - pt.y;
 
-	if (node->getPosition().distanceSquared(pt) > 24*24)
+	unsigned band_id = view->bandAt(view->convertToNodeSpace(pt));
+	if (!band_id)
 		return;
 
-	unsigned band_id = reinterpret_cast<uintptr_t>(node->getUserData());
-	unsigned effect = band_id >> 24;
-
-	band_id &= 0xFFFFFF;
+	unsigned effect = view->getBandData(band_id);
 	if (!effect)
 		effect = 1;
 
@@ -130,7 +131,7 @@ static void onMouseEvent(EventMouse *event, EventMouse::MouseEventType evtype)
 			effect = 1 + effect % 123;
 		else if (event->getScrollY() == -1)
 			effect = 1 + (effect + 121) % 123;
-		node->setUserData(reinterpret_cast<void *>(band_id | (effect << 24)));
+		view->setBandData(band_id, effect);
 		break;
 
 	default:
@@ -144,7 +145,8 @@ static void onMouseEventStub(Event *e)
 	onMouseEvent(static_cast<EventMouse *>(e), MET);
 }
 
-static void attachBandMouseListener(Node *node)
+// one listener for all bands, hit-tested by the view
+static void attachBandMouseListener(BandView *view)
 {
 	EventListenerMouse *evl = EventListenerMouse::create();
 
@@ -153,7 +155,7 @@ static void attachBandMouseListener(Node *node)
 //	evl->onMouseMove   = onMouseEventStub<EventMouse::MouseEventType::MOUSE_MOVE>;
 	evl->onMouseScroll = onMouseEventStub<EventMouse::MouseEventType::MOUSE_SCROLL>;
 
-	node->getEventDispatcher()->addEventListenerWithSceneGraphPriority(evl, node);
+	view->getEventDispatcher()->addEventListenerWithSceneGraphPriority(evl, view);
 }
 
 bool AppDelegate::applicationDidFinishLaunching() {
@@ -200,39 +202,22 @@ bool AppDelegate::applicationDidFinishLaunching() {
     auto scene = HelloWorld::createScene();
 
     scene->addChild(BandInputInjector::create());
+    auto view = static_cast<HelloWorld *>(scene)->getBandView();
+    if (view)
+        attachBandMouseListener(view);
 
-    auto game = std::make_shared<SequenceGame>();
-    auto evl = BandInput::Event::createListener([scene, game] (BandInput::Event *ev) {
-	unsigned band_id = ev->getData().band_id;
-//	std::cerr << "*** event for band #" << band_id << " type " << ev->getEventType() << '\n';
-	auto& hw = *static_cast<HelloWorld *>(scene);
-	if (ev->isBandAdded()) {
-		auto *arrow = hw.addBand(band_id);
-		if (!arrow)
-			return;
-		arrow->setUserData(reinterpret_cast<void *>(band_id));
-		attachBandMouseListener(arrow);
-		game->addBand(band_id, arrow);
-#if 0
-		auto delay = DelayTime::create(1.0f);
-		Vector<FiniteTimeAction *> va(3);
-		va.pushBack(delay);
-		va.pushBack(BandInput::VibeAction::create(band_id, 0x4b8a018a018a4b));
-		va.pushBack(delay);
-		arrow->runAction(Sequence::create(va));
-#endif
-	} else if (ev->isBandRemoved()) {
-		hw.removeBand(band_id);
-		game->removeBand(band_id);
-	} else if (ev->isRawType()) {
-		game->updateBandTime(band_id, ev->getData().detection_ts);
-	} else if (ev->isPitchType()) {
-		float pitch = ev->getPitchData().pitch;
-		hw.updateBandPitch(band_id, pitch);
-		game->updateBandPitch(band_id, ev->getData().detection_ts, pitch);
-	}
+    auto game = std::make_shared<SequenceGame>(SequenceGame::envSessionSize());
+    auto evl = BandInput::Event::createBatchListener([scene, game] (BandInput::Batch *batch) {
+	game->processBatch(*batch, static_cast<HelloWorld *>(scene));
     });
     director->getEventDispatcher()->addEventListenerWithFixedPriority(evl, 1);
+    BandLatency::attach(*director);
+
+    // the game only needs timestamps out of raw samples
+    BandInput::EventFilter filter;
+    filter.raw = BandInput::EventFilter::RAW_HEARTBEAT;
+    filter.n = 8;
+    BandInput::getInstance().setEventFilter(0, filter);
 
     auto kbevl = EventListenerKeyboard::create();
     kbevl->onKeyReleased = [game] (EventKeyboard::KeyCode key, Event *ev) {
@@ -0,0 +1,162 @@
+#include "BandCalibration.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static constexpr size_t JOB_SAMPLES = 1024;
+static constexpr std::chrono::milliseconds POLL{20};	// while jobs are running
+
+BandCalibration::Job::Job(std::string key_)
+	: calib(BandCalibrator::create()), key(std::move(key_)), samples(JOB_SAMPLES), done(false), cancelled(false), zero{}
+{
+}
+
+void BandCalibration::Job::feed(const SensorData *data, size_t n) noexcept
+{
+	for (; n && samples.push(*data); ++data, --n)
+		;
+}
+
+bool BandCalibration::Job::ready(SensorValues& out) const noexcept
+{
+	if (!done.load(std::memory_order_acquire))
+		return false;
+	out = zero;
+	return true;
+}
+
+BandCalibration::BandCalibration(std::string path_)
+	: path(std::move(path_)), stopping(false)
+{
+	load();
+	worker = std::thread(&BandCalibration::run, this);
+}
+
+BandCalibration::~BandCalibration()
+{
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+std::string BandCalibration::device_key(const std::string& name, const DevIdData& devid)
+{
+	char idstr[32];
+	snprintf(idstr, sizeof(idstr), "%hu/%04hX:%04hX/%hu", devid.registry, devid.vendor, devid.product, devid.version);
+	return std::string(idstr) + ' ' + name;
+}
+
+bool BandCalibration::lookup(const std::string& name, const DevIdData& devid, SensorValues& zero)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	auto p = cache.find(device_key(name, devid));
+	if (p == cache.end())
+		return false;
+	zero = p->second;
+	return true;
+}
+
+std::shared_ptr<BandCalibration::Job> BandCalibration::start(const std::string& name, const DevIdData& devid)
+{
+	auto job = std::make_shared<Job>(device_key(name, devid));
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		jobs.push_back(job);
+	}
+	wake.notify_one();
+	return job;
+}
+
+// <key>\t<ax> <ay> <az> <gx> <gy> <gz> per line
+void BandCalibration::load()
+{
+	std::ifstream in(path);
+	std::string line;
+	while (std::getline(in, line)) {
+		auto tab = line.rfind('\t');
+		if (tab == std::string::npos)
+			continue;
+
+		SensorValues v;
+		std::istringstream vals(line.substr(tab + 1));
+		if (vals >> v.ax >> v.ay >> v.az >> v.gx >> v.gy >> v.gz)
+			cache[line.substr(0, tab)] = v;
+	}
+}
+
+void BandCalibration::save(const std::map<std::string, SensorValues>& entries) const
+{
+	std::string tmp = path + ".tmp";
+	{
+		std::ofstream out(tmp);
+		for (auto& e : entries) {
+			const SensorValues& v = e.second;
+			out << e.first << '\t' << v.ax << ' ' << v.ay << ' ' << v.az << ' ' << v.gx << ' ' << v.gy << ' ' << v.gz << '\n';
+		}
+		if (!out.flush()) {
+			std::cerr << "band calibration: can't write " << tmp << '\n';
+			return;
+		}
+	}
+	if (rename(tmp.c_str(), path.c_str()))
+		std::cerr << "band calibration: can't replace " << path << '\n';
+}
+
+void BandCalibration::run()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	std::vector<std::shared_ptr<Job>> active;
+
+	for (;;) {
+		if (jobs.empty())
+			wake.wait(guard, [this] { return stopping || !jobs.empty(); });
+		else
+			wake.wait_for(guard, POLL, [this] { return stopping; });
+		if (stopping)
+			break;
+
+		active = jobs;
+		guard.unlock();
+
+		bool finished = false;
+		for (auto& job : active) {
+			if (job->cancelled.load(std::memory_order_relaxed))
+				continue;
+			for (size_t n = job->samples.readable(); n; --n) {
+				bool ok = job->calib->process(*job->samples.front());
+				job->samples.pop();
+				if (ok) {
+					job->zero = job->calib->zero_offset();
+					job->done.store(true, std::memory_order_release);
+					finished = true;
+					break;
+				}
+			}
+		}
+
+		guard.lock();
+		for (auto p = jobs.begin(); p != jobs.end(); ) {
+			Job& job = **p;
+			if (job.done.load(std::memory_order_relaxed))
+				cache[job.key] = job.zero;
+			if (job.done.load(std::memory_order_relaxed) || job.cancelled.load(std::memory_order_relaxed))
+				p = jobs.erase(p);
+			else
+				++p;
+		}
+
+		if (finished) {
+			auto entries = cache;
+			guard.unlock();
+			save(entries);
+			guard.lock();
+		}
+		active.clear();
+	}
+}
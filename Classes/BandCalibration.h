@@ -0,0 +1,70 @@
+#ifndef BANDGAME_CALIBRATION_H_
+#define BANDGAME_CALIBRATION_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "band.h"
+#include "SpscQueue.h"
+
+// Band calibration off the sample path. A band's producer thread tees its
+// samples into a Job; a worker thread runs them through BandCalibrator and
+// the producer picks the zero offset up once it is ready. Offsets are kept
+// per device (DevIdData and name) in a text file, so a band seen before
+// starts calibrated.
+class BandCalibration
+{
+public:
+	class Job
+	{
+		friend class BandCalibration;
+
+		std::unique_ptr<BandCalibrator> calib;
+		std::string key;
+		SpscQueue<SensorData> samples;
+		std::atomic<bool> done, cancelled;
+		SensorValues zero;
+	public:
+		explicit Job(std::string key_);
+
+		// producer side; samples that don't fit are not needed
+		void feed(const SensorData *data, size_t n) noexcept;
+		// producer side; true when the offset is ready
+		bool ready(SensorValues& out) const noexcept;
+		// the worker forgets the job
+		void cancel() noexcept { cancelled.store(true, std::memory_order_relaxed); }
+	};
+
+	// loads the cache from path if it exists
+	explicit BandCalibration(std::string path_);
+	~BandCalibration();
+
+	BandCalibration(const BandCalibration&) = delete;
+	BandCalibration& operator=(const BandCalibration&) = delete;
+
+	// producer threads; the cached offset, or false
+	bool lookup(const std::string& name, const DevIdData& devid, SensorValues& zero);
+	std::shared_ptr<Job> start(const std::string& name, const DevIdData& devid);
+private:
+	const std::string path;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping;
+	std::map<std::string, SensorValues> cache;
+	std::vector<std::shared_ptr<Job>> jobs;
+	std::thread worker;
+
+	static std::string device_key(const std::string& name, const DevIdData& devid);
+	void load();
+	void save(const std::map<std::string, SensorValues>& entries) const;
+	void run();
+};
+
+#endif /* BANDGAME_CALIBRATION_H_ */
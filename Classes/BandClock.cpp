@@ -0,0 +1,155 @@
+#include "BandClock.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr int64_t BandClock::BUCKET_US;
+constexpr size_t BandClock::POINTS;
+constexpr size_t BandClock::MIN_POINTS;
+
+static constexpr double OUTLIER_MADS = 3.0;
+static constexpr double MIN_MAD = 100;	// [us] below this, residuals are timestamp resolution
+static constexpr double LATE_ALPHA = 1.0 / 64;
+static constexpr double LATE_BOUND_DEVS = 4.0;
+static constexpr double LATE_OUTLIER_DEVS = 8.0;
+static constexpr double MIN_LATE_DEV = 250;	// [us]
+
+void BandClock::reset() noexcept
+{
+	count = next = 0;
+	bucket_end = INT64_MIN;
+	ref_us = 0;
+	base = slope = 0;
+	late_mean = late_dev = 0;
+	last = INT64_MIN;
+
+	fitted.store(false, std::memory_order_relaxed);
+	pub_offset.store(0, std::memory_order_relaxed);
+	pub_drift.store(0, std::memory_order_relaxed);
+	pub_jitter.store(0, std::memory_order_relaxed);
+	pub_outliers.store(0, std::memory_order_relaxed);
+}
+
+void BandClock::observe(uint64_t device_us, int64_t host_us) noexcept
+{
+	int64_t d = host_us - (int64_t)device_us;
+
+	if (bucket_end == INT64_MIN) {
+		bucket = Point{device_us, d};
+		bucket_end = host_us + BUCKET_US;
+		ref_us = device_us;
+		base = d;
+		pub_offset.store(d, std::memory_order_relaxed);
+		return;
+	}
+
+	if (host_us >= bucket_end) {
+		points[next] = bucket;
+		next = (next + 1) % POINTS;
+		if (count < POINTS)
+			++count;
+		if (count >= MIN_POINTS)
+			fit();
+
+		bucket = Point{device_us, d};
+		bucket_end = host_us + BUCKET_US;
+	} else if (d < bucket.delay) {
+		bucket = Point{device_us, d};
+	}
+
+	if (fitted.load(std::memory_order_relaxed)) {
+		late(d - delay_at(device_us));
+	} else if (d < base) {
+		// until there is a line, the fastest transfer so far
+		ref_us = device_us;
+		base = d;
+		pub_offset.store(d, std::memory_order_relaxed);
+	}
+}
+
+// least squares, then again without the points off by more than OUTLIER_MADS
+void BandClock::fit() noexcept
+{
+	uint64_t ref = points[(next + POINTS - count) % POINTS].device_us;
+	double x[POINTS], y[POINTS], r[POINTS];
+	bool in[POINTS];
+
+	for (size_t i = 0; i < count; ++i) {
+		x[i] = (double)(int64_t)(points[i].device_us - ref);
+		y[i] = (double)points[i].delay;
+		in[i] = true;
+	}
+
+	double a = 0, b = 0;
+	for (int pass = 0; pass < 2; ++pass) {
+		double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (!in[i])
+				continue;
+			n += 1;
+			sx += x[i];
+			sy += y[i];
+			sxx += x[i] * x[i];
+			sxy += x[i] * y[i];
+		}
+
+		double den = n * sxx - sx * sx;
+		b = den > 0 ? (n * sxy - sx * sy) / den : 0;
+		a = (sy - b * sx) / n;
+		if (pass)
+			break;
+
+		for (size_t i = 0; i < count; ++i)
+			r[i] = std::abs(y[i] - (a + b * x[i]));
+		std::nth_element(r, r + count / 2, r + count);
+		double limit = OUTLIER_MADS * std::max(r[count / 2], MIN_MAD);
+
+		size_t rejected = 0;
+		for (size_t i = 0; i < count; ++i)
+			if (std::abs(y[i] - (a + b * x[i])) > limit) {
+				in[i] = false;
+				++rejected;
+			}
+		if (!rejected || count - rejected < MIN_POINTS)
+			break;
+	}
+
+	// through the fastest inlier
+	double lo = INFINITY;
+	for (size_t i = 0; i < count; ++i)
+		if (in[i])
+			lo = std::min(lo, y[i] - (a + b * x[i]));
+
+	ref_us = ref;
+	base = a + lo;
+	slope = b;
+
+	uint64_t newest = points[(next + POINTS - 1) % POINTS].device_us;
+	pub_offset.store(std::llround(delay_at(newest)), std::memory_order_relaxed);
+	pub_drift.store((int32_t)std::lround(b * 1e9), std::memory_order_relaxed);
+	fitted.store(true, std::memory_order_relaxed);
+}
+
+// e: delay of one burst above the line
+void BandClock::late(double e) noexcept
+{
+	double dev = std::max(late_dev, MIN_LATE_DEV);
+	if (e > late_mean + LATE_OUTLIER_DEVS * dev) {
+		pub_outliers.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	late_mean += (e - late_mean) * LATE_ALPHA;
+	late_dev += (std::abs(e - late_mean) - late_dev) * LATE_ALPHA;
+	double bound = late_mean + LATE_BOUND_DEVS * std::max(late_dev, MIN_LATE_DEV);
+	pub_jitter.store((uint32_t)std::max(bound, 0.0), std::memory_order_relaxed);
+}
+
+int64_t BandClock::map(uint64_t device_us) noexcept
+{
+	int64_t t = (int64_t)device_us + std::llround(delay_at(device_us));
+	if (t < last)
+		t = last;
+	last = t;
+	return t;
+}
@@ -0,0 +1,75 @@
+#ifndef BANDGAME_CLOCK_H_
+#define BANDGAME_CLOCK_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Maps the sample timestamps of one band onto the host time base
+// (BandInput::now()). The transfer delay (host arrival - band time) of the
+// fastest burst of every BUCKET_US is fitted with a line over the last
+// POINTS buckets, leaving out outliers; the slope is the drift of the band
+// clock. The line is moved down to the fastest inlier, so mapped times are
+// the earliest the samples could have arrived. Mapped times never go back.
+//
+// Delays of single bursts above the line give the jitter: its mean plus
+// four mean deviations is published as the bound on how late a sample is
+// delivered after its mapped time.
+//
+// observe() and map() are called from the band's producer thread, the
+// published estimates may be read from any thread.
+class BandClock
+{
+public:
+	static constexpr int64_t BUCKET_US = 250000;
+	static constexpr size_t POINTS = 64;
+	static constexpr size_t MIN_POINTS = 4;
+
+	BandClock() { reset(); }
+
+	BandClock(const BandClock&) = delete;
+	BandClock& operator=(const BandClock&) = delete;
+
+	void reset() noexcept;
+
+	// device_us is the newest sample of a burst received at host_us
+	void observe(uint64_t device_us, int64_t host_us) noexcept;
+
+	// valid after the first observe()
+	int64_t map(uint64_t device_us) noexcept;
+
+	bool synced() const noexcept { return fitted.load(std::memory_order_relaxed); }
+	int64_t offset() const noexcept { return pub_offset.load(std::memory_order_relaxed); }	// [us] host - band
+	double drift() const noexcept { return pub_drift.load(std::memory_order_relaxed) / 1000.0; }	// [ppm]
+	uint32_t jitter() const noexcept { return pub_jitter.load(std::memory_order_relaxed); }	// [us]
+	uint64_t outliers() const noexcept { return pub_outliers.load(std::memory_order_relaxed); }	// late bursts
+private:
+	struct Point
+	{
+		uint64_t device_us;
+		int64_t delay;	// host - device
+	};
+
+	Point points[POINTS];
+	size_t count, next;
+	Point bucket;
+	int64_t bucket_end;
+
+	// delay = base + slope * (device_us - ref_us)
+	uint64_t ref_us;
+	double base, slope;
+	double late_mean, late_dev;
+	int64_t last;
+
+	std::atomic<bool> fitted;
+	std::atomic<int64_t> pub_offset;
+	std::atomic<int32_t> pub_drift;	// [ppb]
+	std::atomic<uint32_t> pub_jitter;
+	std::atomic<uint64_t> pub_outliers;
+
+	void fit() noexcept;
+	void late(double e) noexcept;
+	double delay_at(uint64_t device_us) const noexcept { return base + slope * (double)(int64_t)(device_us - ref_us); }
+};
+
+#endif /* BANDGAME_CLOCK_H_ */
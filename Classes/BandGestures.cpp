@@ -0,0 +1,258 @@
+#include "BandGestures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "SensorConvert.h"
+
+using Kind = BandInput::GestureValue::Kind;
+
+static constexpr int STABLE_ROT = 200;
+static constexpr double STABLE_FORCE_DIFF = 0.15;
+static constexpr size_t STABLE_WINDOW = 4;	// samples that must all be stable
+
+static constexpr float SHAKE_FORCE = 0.5;	// [g] off the window mean to count as a half-swing
+static constexpr unsigned SHAKE_FLIPS = 4;
+static constexpr int64_t SHAKE_SPAN = 800000;	// [us]
+static constexpr int64_t SHAKE_REFRACTORY = 500000;	// [us]
+
+static constexpr float TAP_FORCE = 1.5;		// [g] off 1g
+static constexpr float TAP_QUIET_FORCE = 0.3;	// [g] off 1g before the spike
+static constexpr size_t TAP_QUIET_WINDOW = 8;
+static constexpr int64_t TAP_REFRACTORY = 150000;	// [us]
+
+static constexpr float ROT_MIN_RATE = 0.25;	// [360deg/s]
+static constexpr float ROT_MIN_TURNS = 0.25;
+static constexpr int64_t ROT_MAX_DT = 100000;	// [us] gaps longer than this are not integrated
+
+static constexpr float SWING_RATE = 1.0;	// [360deg/s]
+
+void GestureEmitter::emit_pitch(unsigned id, float pitch) noexcept
+{
+	BandInput::EventRecord rec;
+	::new (static_cast<void *>(&rec)) BandInput::GesturePitchValue(id, sample_ts, pitch);
+	emit(rec);
+}
+
+void GestureEmitter::emit_gesture(unsigned id, Kind kind, float value) noexcept
+{
+	BandInput::EventRecord rec;
+	::new (static_cast<void *>(&rec)) BandInput::GestureValue(id, sample_ts, kind, value);
+	emit(rec);
+}
+
+namespace {
+
+// band held still: reports its pitch, 1 is up, -1 is down
+struct PitchDetector final : public GestureDetector
+{
+	virtual void process(unsigned id, const SampleHistory::Window& win, GestureEmitter& out) noexcept override
+	{
+		auto w = win.last(STABLE_WINDOW);
+		if (w.n < STABLE_WINDOW)
+			return;
+
+		float rot = std::max({
+			history::max_abs(w[SampleHistory::GX], w.n),
+			history::max_abs(w[SampleHistory::GY], w.n),
+			history::max_abs(w[SampleHistory::GZ], w.n),
+		});
+		if (rot > STABLE_ROT / ROT_360)
+			return;
+
+		double fa = history::mean(w[SampleHistory::MAG], w.n) - 1;
+		if (std::abs(fa) > STABLE_FORCE_DIFF)
+			return;
+
+		out.emit_pitch(id, history::mean(w[SampleHistory::PITCH], w.n));
+	}
+};
+
+// repeated back-and-forth acceleration along one axis
+struct ShakeDetector final : public GestureDetector
+{
+	int last_dir = 0;	// +-(axis + 1)
+	unsigned flips = 0;
+	float peak = 0;
+	int64_t first_ts = 0, quiet_until = 0;
+
+	virtual void process(unsigned id, const SampleHistory::Window& w, GestureEmitter& out) noexcept override
+	{
+		int64_t ts = w.ts[w.n - 1];
+
+		// deviation from the window mean removes gravity and slow motion
+		int axis = 0;
+		float d = 0;
+		for (int c = SampleHistory::AX; c <= SampleHistory::AZ; ++c) {
+			auto ch = w[(SampleHistory::Channel)c];
+			float dc = ch[w.n - 1] - history::mean(ch, w.n);
+			if (std::abs(dc) > std::abs(d)) {
+				d = dc;
+				axis = c + 1;
+			}
+		}
+
+		if (flips)
+			peak = std::max(peak, std::abs(d));
+
+		if (std::abs(d) < SHAKE_FORCE)
+			return;
+
+		int dir = d > 0 ? axis : -axis;
+		if (dir == last_dir)
+			return;
+
+		if (last_dir == -dir) {
+			if (!flips || ts - first_ts > SHAKE_SPAN) {
+				flips = 0;
+				first_ts = ts;
+				peak = std::abs(d);
+			}
+
+			if (++flips >= SHAKE_FLIPS && ts >= quiet_until) {
+				out.emit_gesture(id, BandInput::GestureValue::SHAKE, peak);
+				flips = 0;
+				quiet_until = ts + SHAKE_REFRACTORY;
+			}
+		}
+		last_dir = dir;
+	}
+};
+
+// single sharp spike after the band was still
+struct TapDetector final : public GestureDetector
+{
+	int64_t quiet_until = 0;
+
+	virtual void process(unsigned id, const SampleHistory::Window& win, GestureEmitter& out) noexcept override
+	{
+		if (win.n < TAP_QUIET_WINDOW + 1)
+			return;
+
+		int64_t ts = win.ts[win.n - 1];
+		float d = std::abs(win[SampleHistory::MAG][win.n - 1] - 1);
+		if (d < TAP_FORCE || ts < quiet_until)
+			return;
+
+		auto w = win.last(TAP_QUIET_WINDOW + 1);
+		--w.n;	// samples before the spike
+		float lo = history::min(w[SampleHistory::MAG], w.n), hi = history::max(w[SampleHistory::MAG], w.n);
+		if (hi - 1 > TAP_QUIET_FORCE || 1 - lo > TAP_QUIET_FORCE)
+			return;
+
+		out.emit_gesture(id, BandInput::GestureValue::TAP, d);
+		quiet_until = ts + TAP_REFRACTORY;
+	}
+};
+
+// twist around the band's X axis, reported once the band stops turning
+struct RotationDetector final : public GestureDetector
+{
+	float angle = 0;
+	int64_t prev_ts = 0;
+	bool active = false;
+
+	virtual void process(unsigned id, const SampleHistory::Window& w, GestureEmitter& out) noexcept override
+	{
+		int64_t ts = w.ts[w.n - 1];
+		float rate = w[SampleHistory::GX][w.n - 1];
+		int64_t dt = ts - prev_ts;
+		prev_ts = ts;
+
+		if (std::abs(rate) >= ROT_MIN_RATE) {
+			if (active && dt > 0 && dt < ROT_MAX_DT)
+				angle += rate * (dt / 1000000.0f);
+			active = true;
+			return;
+		}
+
+		if (active && std::abs(angle) >= ROT_MIN_TURNS)
+			out.emit_gesture(id, BandInput::GestureValue::ROTATION, angle);
+		active = false;
+		angle = 0;
+	}
+};
+
+// fast arm movement, reported with its peak angular rate when it slows down
+struct SwingDetector final : public GestureDetector
+{
+	float peak = 0;
+
+	virtual void process(unsigned id, const SampleHistory::Window& w, GestureEmitter& out) noexcept override
+	{
+		size_t i = w.n - 1;
+		float gx = w[SampleHistory::GX][i], gy = w[SampleHistory::GY][i], gz = w[SampleHistory::GZ][i];
+		float rate = std::sqrt(gx * gx + gy * gy + gz * gz);
+
+		if (rate >= SWING_RATE) {
+			peak = std::max(peak, rate);
+			return;
+		}
+
+		if (peak && rate < SWING_RATE / 2) {
+			out.emit_gesture(id, BandInput::GestureValue::SWING, peak);
+			peak = 0;
+		}
+	}
+};
+
+template <typename T>
+std::unique_ptr<GestureDetector> make_detector()
+{
+	return std::make_unique<T>();
+}
+
+struct Registry
+{
+	std::mutex lock;
+	std::vector<std::pair<std::string, GestureEngine::Factory>> factories{
+		{ "pitch", make_detector<PitchDetector> },
+		{ "shake", make_detector<ShakeDetector> },
+		{ "tap", make_detector<TapDetector> },
+		{ "rotation", make_detector<RotationDetector> },
+		{ "swing", make_detector<SwingDetector> },
+	};
+};
+
+Registry& registry()
+{
+	static Registry r;
+	return r;
+}
+
+} /* namespace */
+
+void GestureEngine::registerDetector(const std::string& name, Factory factory)
+{
+	auto& r = registry();
+	std::unique_lock<std::mutex> lock(r.lock);
+
+	auto p = std::find_if(r.factories.begin(), r.factories.end(), [&name] (const auto& f) { return f.first == name; });
+	if (p != r.factories.end())
+		p->second = std::move(factory);
+	else
+		r.factories.emplace_back(name, std::move(factory));
+}
+
+GestureEngine::GestureEngine()
+{
+	auto& r = registry();
+	std::unique_lock<std::mutex> lock(r.lock);
+
+	for (auto& f : r.factories)
+		if (f.second)
+			detectors.emplace_back(f.second());
+}
+
+void GestureEngine::process(unsigned id, const SampleHistory& h, size_t skip, GestureEmitter& out) noexcept
+{
+	auto w = h.window(WINDOW, skip);
+	if (!w.n)
+		return;
+
+	for (auto& d : detectors)
+		d->process(id, w, out);
+}
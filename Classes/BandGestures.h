@@ -0,0 +1,56 @@
+#ifndef BANDGAME_GESTURES_H_
+#define BANDGAME_GESTURES_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BandHistory.h"
+#include "BandInput.h"
+
+// Receives records produced by detectors of one band.
+struct GestureEmitter
+{
+	virtual void emit(const BandInput::EventRecord& rec) noexcept = 0;
+
+	// stamped with sample_ts
+	void emit_pitch(unsigned id, float pitch) noexcept;
+	void emit_gesture(unsigned id, BandInput::GestureValue::Kind kind, float value) noexcept;
+protected:
+	int64_t sample_ts = 0;	// host time of the sample being processed
+
+	~GestureEmitter() = default;
+};
+
+// Incremental detector run on the band I/O thread for every sample.
+// Must use O(1) time and fixed state per sample.
+struct GestureDetector
+{
+	virtual ~GestureDetector() = default;
+
+	// `w` holds up to GestureEngine::WINDOW samples ending with the current one
+	virtual void process(unsigned id, const SampleHistory::Window& w, GestureEmitter& out) noexcept = 0;
+};
+
+// Per-band set of detectors, instantiated from the global registry.
+class GestureEngine
+{
+	std::vector<std::unique_ptr<GestureDetector>> detectors;
+public:
+	static constexpr size_t WINDOW = 16;
+
+	using Factory = std::function<std::unique_ptr<GestureDetector>()>;
+
+	// affects bands connected afterwards; a detector registered under an
+	// existing name replaces it, a null factory disables it
+	static void registerDetector(const std::string& name, Factory factory);
+
+	GestureEngine();
+
+	// evaluate the sample `skip` positions before the newest one in `h`
+	void process(unsigned id, const SampleHistory& h, size_t skip, GestureEmitter& out) noexcept;
+};
+
+#endif /* BANDGAME_GESTURES_H_ */
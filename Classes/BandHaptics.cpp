@@ -0,0 +1,177 @@
+#include "BandHaptics.h"
+
+#include <algorithm>
+
+static constexpr size_t HAPTIC_QUEUE_SIZE = 1024;
+
+constexpr std::chrono::milliseconds HapticQueue::MIN_INTERVAL;
+
+HapticQueue::HapticQueue(Sender send_)
+	: send(std::move(send_)), cmds(HAPTIC_QUEUE_SIZE), stopping(false), coalesced(0)
+{
+	worker = std::thread(&HapticQueue::run, this);
+}
+
+HapticQueue::~HapticQueue()
+{
+	stop();
+}
+
+void HapticQueue::stop()
+{
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	if (worker.joinable())
+		worker.join();
+}
+
+void HapticQueue::push(unsigned band_id, uint64_t effect, Priority prio) noexcept
+{
+	if (!cmds.push(Command{band_id, prio, effect}))
+		return;
+
+	// the worker only holds the lock while it sleeps
+	{
+		std::unique_lock<std::mutex> guard(lock);
+	}
+	wake.notify_one();
+}
+
+void HapticQueue::play(unsigned session, std::vector<Cue> cues)
+{
+	std::stable_sort(cues.begin(), cues.end(), [] (const Cue& a, const Cue& b) { return a.at_us < b.at_us; });
+	Timeline t{session, std::chrono::steady_clock::now(), std::move(cues), 0};
+
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		incoming.push_back(std::move(t));
+	}
+	wake.notify_one();
+}
+
+void HapticQueue::queue(unsigned band_id, uint64_t effect, Priority prio) noexcept
+{
+	auto p = bands.emplace(band_id, BandState{});
+	BandState& b = p.first->second;
+	if (b.pending[prio])
+		coalesced.fetch_add(1, std::memory_order_relaxed);
+	b.pending[prio] = true;
+	b.effect[prio] = effect;
+}
+
+void HapticQueue::drain() noexcept
+{
+	for (size_t n = cmds.readable(); n; --n) {
+		const Command& c = *cmds.front();
+		queue(c.band_id, c.effect, c.prio);
+		cmds.pop();
+	}
+}
+
+void HapticQueue::adopt(std::vector<Timeline>& fresh)
+{
+	for (auto& t : fresh) {
+		auto p = std::find_if(timelines.begin(), timelines.end(), [&t] (const Timeline& r) { return r.session == t.session; });
+		if (p != timelines.end())
+			timelines.erase(p);
+		if (!t.cues.empty())
+			timelines.push_back(std::move(t));
+	}
+	fresh.clear();
+}
+
+// moves due cues to their bands, returns when the next one is due
+std::chrono::steady_clock::time_point HapticQueue::play_due()
+{
+	using namespace std::chrono;
+
+	auto now = steady_clock::now();
+	auto next = steady_clock::time_point::max();
+
+	for (auto p = timelines.begin(); p != timelines.end(); ) {
+		Timeline& t = *p;
+		for (; t.pos < t.cues.size(); ++t.pos) {
+			const Cue& c = t.cues[t.pos];
+			auto due = t.start + microseconds(c.at_us);
+			if (due > now) {
+				next = std::min(next, due);
+				break;
+			}
+			queue(c.band_id, c.effect, Priority::PLAYBACK);
+		}
+
+		if (t.pos == t.cues.size())
+			p = timelines.erase(p);
+		else
+			++p;
+	}
+
+	return next;
+}
+
+// sends what is due, returns when to look again
+std::chrono::steady_clock::time_point HapticQueue::send_due()
+{
+	using namespace std::chrono;
+
+	auto now = steady_clock::now();
+	auto next = steady_clock::time_point::max();
+
+	for (int prio = Priority::PRIORITIES - 1; prio >= 0; --prio) {
+		for (auto p = bands.begin(); p != bands.end(); ) {
+			BandState& b = p->second;
+			if (!b.pending[prio]) {
+				++p;
+				continue;
+			}
+
+			auto due = b.last_sent + MIN_INTERVAL;
+			if (due > now) {
+				next = std::min(next, due);
+				++p;
+				continue;
+			}
+
+			b.pending[prio] = false;
+			b.last_sent = now;
+			if (!send(p->first, b.effect[prio])) {
+				p = bands.erase(p);
+				continue;
+			}
+
+			if (b.pending[Priority::FEEDBACK] || b.pending[Priority::PLAYBACK])
+				next = std::min(next, now + MIN_INTERVAL);
+			++p;
+		}
+	}
+
+	return next;
+}
+
+void HapticQueue::run()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	auto next = std::chrono::steady_clock::time_point::max();
+	std::vector<Timeline> fresh;
+
+	for (;;) {
+		auto ready = [this] { return stopping || cmds.readable() || !incoming.empty(); };
+		if (next == std::chrono::steady_clock::time_point::max())
+			wake.wait(guard, ready);
+		else
+			wake.wait_until(guard, next, ready);
+		if (stopping)
+			break;
+		fresh.swap(incoming);
+
+		guard.unlock();
+		drain();
+		adopt(fresh);
+		next = play_due();
+		next = std::min(next, send_due());
+		guard.lock();
+	}
+}
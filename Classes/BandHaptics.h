@@ -0,0 +1,95 @@
+#ifndef BANDGAME_HAPTICS_H_
+#define BANDGAME_HAPTICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BandInput.h"
+#include "SpscQueue.h"
+
+// Vibe requests from the cocos thread, sent to the bands by a worker thread.
+// Requests for one band are coalesced: a newer effect replaces a pending one
+// of the same priority, and a band gets at most one effect per MIN_INTERVAL.
+// FEEDBACK effects are sent before any PLAYBACK ones. Timelines of cues are
+// replayed by the worker as PLAYBACK effects at their due time.
+class HapticQueue
+{
+public:
+	using Priority = BandInput::VibeAction::Priority;
+	using Cue = BandInput::VibeAction::Cue;
+
+	// returns false when the band is gone
+	using Sender = std::function<bool(unsigned band_id, uint64_t effect)>;
+
+	static constexpr std::chrono::milliseconds MIN_INTERVAL{40};
+
+	explicit HapticQueue(Sender send_);
+	~HapticQueue();
+
+	HapticQueue(const HapticQueue&) = delete;
+	HapticQueue& operator=(const HapticQueue&) = delete;
+
+	// single producer; never waits for a device
+	void push(unsigned band_id, uint64_t effect, Priority prio) noexcept;
+
+	// starts the cues relative to now; an empty list cancels the session's timeline
+	void play(unsigned session, std::vector<Cue> cues);
+
+	// no effect is sent after this returns
+	void stop();
+
+	uint64_t coalescedCount() const noexcept { return coalesced.load(std::memory_order_relaxed); }
+	uint64_t droppedCount() const noexcept { return cmds.overflowCount(); }
+private:
+	struct Command
+	{
+		unsigned band_id;
+		Priority prio;
+		uint64_t effect;
+	};
+
+	struct Timeline
+	{
+		unsigned session;
+		std::chrono::steady_clock::time_point start;
+		std::vector<Cue> cues;	// sorted by at_us
+		size_t pos;
+	};
+
+	struct BandState
+	{
+		bool pending[Priority::PRIORITIES];
+		uint64_t effect[Priority::PRIORITIES];
+		std::chrono::steady_clock::time_point last_sent;
+	};
+
+	Sender send;
+	SpscQueue<Command> cmds;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping;
+	std::vector<Timeline> incoming;	// guarded by lock
+	std::thread worker;
+
+	// worker only
+	std::unordered_map<unsigned, BandState> bands;
+	std::vector<Timeline> timelines;
+	std::atomic<uint64_t> coalesced;
+
+	void run();
+	void queue(unsigned band_id, uint64_t effect, Priority prio) noexcept;
+	void drain() noexcept;
+	void adopt(std::vector<Timeline>& fresh);
+	std::chrono::steady_clock::time_point play_due();
+	std::chrono::steady_clock::time_point send_due();
+};
+
+#endif /* BANDGAME_HAPTICS_H_ */
@@ -0,0 +1,210 @@
+#include "BandHistory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+SampleHistory::SampleHistory(size_t capacity)
+	: cap(capacity ? capacity : 1), head(0), count(0),
+	  data(static_cast<float *>(::operator new[](CHANNELS * 2 * cap * sizeof(float), std::align_val_t(ALIGN)))),
+	  stamps(new int64_t[2 * cap])
+{
+}
+
+void SampleHistory::push(int64_t ts, const float (&v)[CHANNELS]) noexcept
+{
+	for (size_t c = 0; c < CHANNELS; ++c) {
+		float *p = channel(c);
+		p[head] = p[head + cap] = v[c];
+	}
+
+	stamps[head] = stamps[head + cap] = ts;
+
+	if (++head == cap)
+		head = 0;
+	++count;
+}
+
+template <typename T>
+void SampleHistory::append(T *dst, const T *src, size_t n) const noexcept
+{
+	size_t first = std::min(n, cap - head);
+	std::memcpy(dst + head, src, first * sizeof(T));
+	std::memcpy(dst + head + cap, src, first * sizeof(T));
+	std::memcpy(dst, src + first, (n - first) * sizeof(T));
+	std::memcpy(dst + cap, src + first, (n - first) * sizeof(T));
+}
+
+void SampleHistory::push(const int64_t *ts, const float *v, size_t stride, size_t n) noexcept
+{
+	// only the newest cap samples can survive
+	size_t drop = n > cap ? n - cap : 0;
+	head = (head + drop) % cap;
+	count += drop;
+	n -= drop;
+
+	for (size_t c = 0; c < CHANNELS; ++c)
+		append(channel(c), v + c * stride + drop, n);
+	append(stamps.get(), ts + drop, n);
+
+	head = (head + n) % cap;
+	count += n;
+}
+
+SampleHistory::Window SampleHistory::window(size_t n, size_t skip) const noexcept
+{
+	Window w;
+	size_t avail = size();
+	skip = std::min(skip, avail);
+	w.n = std::min(n, avail - skip);
+
+	// head + cap is one past the newest sample in the mirrored half
+	size_t start = head + cap - skip - w.n;
+	for (size_t c = 0; c < CHANNELS; ++c)
+		w.ch[c] = channel(c) + start;
+	w.ts = stamps.get() + start;
+
+	return w;
+}
+
+namespace history {
+
+typedef float v4sf __attribute__((vector_size(16)));
+
+static inline v4sf load4(const float *p) noexcept
+{
+	v4sf v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline v4sf splat4(float x) noexcept
+{
+	return v4sf{x, x, x, x};
+}
+
+static inline float hsum4(v4sf v) noexcept
+{
+	return (v[0] + v[1]) + (v[2] + v[3]);
+}
+
+static inline v4sf min4(v4sf a, v4sf b) noexcept
+{
+	return a < b ? a : b;
+}
+
+static inline v4sf max4(v4sf a, v4sf b) noexcept
+{
+	return a > b ? a : b;
+}
+
+float sum(const float *p, size_t n) noexcept
+{
+	v4sf acc = splat4(0);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		acc += load4(p + i);
+
+	float s = hsum4(acc);
+	for (; i < n; ++i)
+		s += p[i];
+	return s;
+}
+
+float mean(const float *p, size_t n) noexcept
+{
+	return n ? sum(p, n) / n : 0;
+}
+
+float variance(const float *p, size_t n) noexcept
+{
+	if (n < 2)
+		return 0;
+
+	float m = mean(p, n);
+	v4sf vm = splat4(m);
+	v4sf acc = splat4(0);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		v4sf d = load4(p + i) - vm;
+		acc += d * d;
+	}
+
+	float s = hsum4(acc);
+	for (; i < n; ++i)
+		s += (p[i] - m) * (p[i] - m);
+	return s / n;
+}
+
+float min(const float *p, size_t n) noexcept
+{
+	v4sf acc = splat4(std::numeric_limits<float>::infinity());
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = min4(acc, load4(p + i));
+
+	float r = std::min(std::min(acc[0], acc[1]), std::min(acc[2], acc[3]));
+	for (; i < n; ++i)
+		r = std::min(r, p[i]);
+	return r;
+}
+
+float max(const float *p, size_t n) noexcept
+{
+	v4sf acc = splat4(-std::numeric_limits<float>::infinity());
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = max4(acc, load4(p + i));
+
+	float r = std::max(std::max(acc[0], acc[1]), std::max(acc[2], acc[3]));
+	for (; i < n; ++i)
+		r = std::max(r, p[i]);
+	return r;
+}
+
+float max_abs(const float *p, size_t n) noexcept
+{
+	v4sf acc = splat4(0);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		v4sf v = load4(p + i);
+		acc = max4(acc, max4(v, -v));
+	}
+
+	float r = std::max(std::max(acc[0], acc[1]), std::max(acc[2], acc[3]));
+	for (; i < n; ++i)
+		r = std::max(r, std::abs(p[i]));
+	return r;
+}
+
+void magnitude(const float *x, const float *y, const float *z, float *out, size_t n) noexcept
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		v4sf vx = load4(x + i), vy = load4(y + i), vz = load4(z + i);
+		v4sf sq = vx * vx + vy * vy + vz * vz;
+		for (int k = 0; k < 4; ++k)
+			out[i + k] = std::sqrt(sq[k]);
+	}
+
+	for (; i < n; ++i)
+		out[i] = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+}
+
+float mean_magnitude(const float *x, const float *y, const float *z, size_t n) noexcept
+{
+	float s = 0;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		v4sf vx = load4(x + i), vy = load4(y + i), vz = load4(z + i);
+		v4sf sq = vx * vx + vy * vy + vz * vz;
+		s += (std::sqrt(sq[0]) + std::sqrt(sq[1])) + (std::sqrt(sq[2]) + std::sqrt(sq[3]));
+	}
+
+	for (; i < n; ++i)
+		s += std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+	return n ? s / n : 0;
+}
+
+} /* namespace history */
@@ -0,0 +1,85 @@
+#ifndef BANDGAME_HISTORY_H_
+#define BANDGAME_HISTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+// Circular per-band history of converted samples, one array per channel.
+// Every sample is written twice (at i and i + capacity), so the newest n
+// samples are always contiguous and windows are plain arrays.
+class SampleHistory
+{
+public:
+	// MAG and PITCH are derived from the acceleration by convert_samples()
+	enum Channel { AX, AY, AZ, GX, GY, GZ, MAG, PITCH, CHANNELS };
+
+	struct Window
+	{
+		const float *ch[CHANNELS];	// [g], [360deg/s], [g], [-1..1]
+		const int64_t *ts;	// [us] device time
+		size_t n;
+
+		const float *operator[](Channel c) const { return ch[c]; }
+
+		// newest min(k, n) samples of this window
+		Window last(size_t k) const noexcept
+		{
+			Window w = *this;
+			size_t off = k < n ? n - k : 0;
+			for (auto& p : w.ch)
+				p += off;
+			w.ts += off;
+			w.n -= off;
+			return w;
+		}
+	};
+
+	explicit SampleHistory(size_t capacity = 256);
+
+	void push(int64_t ts, const float (&v)[CHANNELS]) noexcept;
+	// append n samples; channel c is read from v + c * stride
+	void push(const int64_t *ts, const float *v, size_t stride, size_t n) noexcept;
+	void clear() noexcept { count = 0; }
+
+	size_t size() const noexcept { return count < cap ? count : cap; }
+	size_t capacity() const noexcept { return cap; }
+
+	// newest min(n, size() - skip) samples not counting the last `skip`, oldest first; O(1)
+	Window window(size_t n, size_t skip = 0) const noexcept;
+private:
+	static constexpr size_t ALIGN = 32;
+
+	struct AlignedDelete
+	{
+		void operator()(float *p) const { ::operator delete[](p, std::align_val_t(ALIGN)); }
+	};
+
+	const size_t cap;
+	size_t head, count;
+	std::unique_ptr<float[], AlignedDelete> data;	// CHANNELS x 2 x cap
+	std::unique_ptr<int64_t[]> stamps;	// 2 x cap
+
+	float *channel(size_t c) const noexcept { return data.get() + c * 2 * cap; }
+	template <typename T>
+	void append(T *dst, const T *src, size_t n) const noexcept;
+};
+
+// window reductions; vectorized 4 lanes at a time with a scalar tail
+namespace history {
+
+float sum(const float *p, size_t n) noexcept;
+float mean(const float *p, size_t n) noexcept;
+float variance(const float *p, size_t n) noexcept;
+float min(const float *p, size_t n) noexcept;
+float max(const float *p, size_t n) noexcept;
+float max_abs(const float *p, size_t n) noexcept;
+
+// out[i] = |(x[i], y[i], z[i])|
+void magnitude(const float *x, const float *y, const float *z, float *out, size_t n) noexcept;
+float mean_magnitude(const float *x, const float *y, const float *z, size_t n) noexcept;
+
+} /* namespace history */
+
+#endif /* BANDGAME_HISTORY_H_ */
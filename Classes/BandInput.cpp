@@ -1,17 +1,22 @@
 #include "BandInput.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cerrno>
 #include <cmath>
 #include <cstring>
-#include <deque>
 #include <exception>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <numeric>
+#include <sstream>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <linux/input.h>
 #include <sys/epoll.h>
@@ -21,107 +26,115 @@
 
 #include "band.h"
 #include "vecs.h"
-
-#define DO_CALIB 0
+#include "BandInputImpl.h"
+#include "BandLatency.h"
+#include "BandLog.h"
+#include "BandWorkers.h"
 
 BandInput::BandInput() {}
 
-static constexpr double MAG_1G = 1000000.0 / 488;
-static constexpr double ROT_360 = 360000.0 / 70;
-static constexpr int STABLE_ROT = 200;
-static constexpr double STABLE_FORCE_DIFF = 0.15;
+static constexpr size_t EVQ_SIZE = 16384;
+static constexpr size_t EVQ_CTRL_RESERVE = 64;	// slots kept free for ADDED/REMOVED
 
 const std::string BandInput::Event::event_name = "band_gesture_event";
+const std::string BandInput::Batch::event_name = "band_gesture_batch";
 
-struct BandInfo;
-struct VibeActionImpl;
-
-struct BandInputImpl : public BandInput
+// EventFilter packed for lock-free access from the I/O thread; 0 means "use default"
+static uint64_t pack_filter(const BandInput::EventFilter& f)
 {
-	std::unique_ptr<BandManager> mgr;
-	std::thread iothread;
-	std::set<std::unique_ptr<BandInfo>, std::less<void>> bands;
-	std::deque<std::unique_ptr<EventData>> evq;
-
-	BandInputImpl();
-	virtual ~BandInputImpl();
-
-	virtual void checkEvents(cocos2d::EventDispatcher&);
-
-	void on_band_found(BandDeviceLL *ll);
-	void on_band_lost(BandInfo *bandinfo);
+	return (uint64_t)(f.type_mask & 0xFFFF) | (uint64_t)(f.raw & 0xFF) << 16 | (uint64_t)std::max(f.n, 1u) << 32;
+}
 
-	void on_band_calibrated(BandInfo& bandinfo, std::unique_ptr<BandCalibrator> calib);
+static BandInput::EventFilter unpack_filter(uint64_t v)
+{
+	BandInput::EventFilter f;
+	f.type_mask = v & 0xFFFF;
+	f.raw = (BandInput::EventFilter::RawPolicy)((v >> 16) & 0xFF);
+	f.n = v >> 32;
+	return f;
+}
 
-	BandInfo *find_band(unsigned id) const;
+struct VibeActionImpl final : public BandInput::VibeAction
+{
+	VibeActionImpl(unsigned ud, uint64_t effect_, Priority prio_);
 
-	void push_event(std::unique_ptr<EventData> ev);
+	virtual VibeActionImpl *clone() const override;
+	virtual VibeActionImpl *reverse() const override;
+	virtual void update(float time) override;
 
-	template <typename T, typename... Args>
-	void push_new_event(Args&&... args)
-	{
-		push_event(std::make_unique<T>(std::forward<Args>(args)...));
-	}
+	uint64_t effect;
+	unsigned id;
+	Priority prio;
 };
 
-struct BandInfo final : public BandDevice
-{
-	BandInputImpl& mgr;
-	unsigned id;
-	std::string my_name;
+struct HwBandInfo;
 
-	std::unique_ptr<BandCalibrator> calib;
+// libgameinn device, called back on the I/O thread
+struct HwBandDevice final : public BandDevice
+{
+	HwBandInfo& info;
 
-	BandInfo(BandInputImpl&, BandDeviceLL *);
+	HwBandDevice(HwBandInfo& info_, BandDeviceLL *bll);
 
 	virtual void device_initialized(const std::string& name, uint64_t ts, const DevIdData& devid) noexcept override;
 	virtual void device_removed() noexcept override;
 	virtual void data_received(SensorData data) noexcept override;
 };
 
-struct VibeActionImpl final : public BandInput::VibeAction
+// Processing state of a libgameinn device. With workers, it is only used
+// by the band's shard worker, while the device stays on the I/O thread.
+struct HwBandInfo final : public BandInfo
 {
-	VibeActionImpl(unsigned ud, uint64_t effect_);
+	BandWorkers::Shard *shard;	// null: processed on the I/O thread
+	std::unique_ptr<HwBandDevice> device;	// I/O thread; reset under bands_lock once removed
 
-	virtual VibeActionImpl *clone() const override;
-	virtual VibeActionImpl *reverse() const override;
-	virtual void update(float time) override;
+	// zero offset found on the worker, applied by the I/O thread
+	SensorValues pending_zero;
+	std::atomic<bool> zero_pending;
 
-	uint64_t effect;
-	unsigned id;
-};
+	HwBandInfo(BandInputImpl&, BandDeviceLL *, BandWorkers::Shard *);
 
-namespace std {
+	void device_initialized(const std::string& name, uint64_t ts, const DevIdData& devid) noexcept;
+	// destroys the device
+	void device_removed() noexcept;
+	void data_received(SensorData data) noexcept;
 
-template <typename T>
-static bool operator<(const unique_ptr<T>& a, const T *b)
-{
-	return std::less<const T *>()(a.get(), b);
-}
+	virtual void vibe(uint64_t effect) override;
+protected:
+	virtual void calibrated(const SensorValues& zero) noexcept override;
+};
 
-template <typename T>
-static bool operator<(const T *a, const unique_ptr<T>& b)
+struct HwBandInput final : public BandInputImpl
 {
-	return std::less<const T *>()(a, b.get());
-}
+	std::unique_ptr<BandManager> mgr;
+	std::unique_ptr<BandWorkers> workers;
+	std::thread iothread;
 
-} /* namespace std */
+	HwBandInput();
+	virtual ~HwBandInput();
+
+	void on_band_found(BandDeviceLL *ll);
+};
 
 static std::mutex insys_lock;
 static std::unique_ptr<BandInputImpl> insys;
-static unsigned next_band_id = 1;
 
-BandInfo::BandInfo(BandInputImpl& mgr_, BandDeviceLL *bll)
-	: mgr(mgr_), id(next_band_id++)
+BandInfo::BandInfo(BandInputImpl& mgr_, BandEventQueue& evq_)
+	: mgr(mgr_), evq(evq_), id(0), filter(0), produced(0), filtered(0), shared(nullptr), arrival_us(0), raw_filter(0), raw_count(0)
 {
-	if (DO_CALIB)
-		calib = BandCalibrator::create();
-	BandDevice::operator=(bll);
 }
 
-void BandInfo::device_initialized(const std::string& name, uint64_t ts, const DevIdData& devid) noexcept
+BandInfo::~BandInfo()
+{
+	if (calib)
+		calib->cancel();
+}
+
+void BandInfo::initialized(const std::string& name, uint64_t ts, const DevIdData& devid) noexcept
 {
 	my_name = name;
+	if (mgr.recorder)
+		mgr.recorder->arrival(id, host_time_us(), name, ts, devid);
 
 	char idstr[32];
 	snprintf(idstr, sizeof(idstr) - 1, "%hu/%04hX:%04hX/%hu", devid.registry, devid.vendor, devid.product, devid.version);
@@ -129,162 +142,698 @@ void BandInfo::device_initialized(const std::string& name, uint64_t ts, const De
 
 	std::cerr << "band #" << id << " using " << name << " (" << idstr << ") ts " << ts << "\n";
 
-	mgr.push_new_event<BandInput::EventData>(BandInput::EventData::ADDED, id, ts);
+	SensorValues zero;
+	if (mgr.calibration && mgr.calibration->lookup(name, devid, zero))
+		calibrated(zero);
+	else if (mgr.calibration)
+		calib = mgr.calibration->start(name, devid);
+
+	evq.push_new_event<BandInput::EventData>(BandInput::EventData::ADDED, id, BandInput::now());
 }
 
-void BandInfo::device_removed() noexcept
+void BandInfo::removed() noexcept
 {
-	if (!my_name.empty())
-		mgr.push_new_event<BandInput::EventData>(BandInput::EventData::REMOVED, id, 0);
-	mgr.on_band_lost(this);
+	if (my_name.empty())
+		return;
+	if (mgr.recorder)
+		mgr.recorder->removal(id, host_time_us());
+	if (clock.synced())
+		std::cerr << "band #" << id << " clock drift " << clock.drift() << " ppm jitter " << clock.jitter() << " us, " << clock.outliers() << " late bursts\n";
+	evq.push_new_event<BandInput::EventData>(BandInput::EventData::REMOVED, id, BandInput::now());
 }
 
-void BandInfo::data_received(SensorData data) noexcept
+void BandInfo::process_samples(const SensorData *data, size_t n) noexcept
 {
+	int64_t host_us = BandInput::now();
+	arrival_us = BandLatency::enabled() ? BandLatency::now() : 0;
+	if (mgr.recorder)
+		mgr.recorder->samples(id, host_us, data, n);
+
 	if (calib) {
-		if (calib->process(data))
-			mgr.on_band_calibrated(*this, std::move(calib));
+		SensorValues zero;
+		calib->feed(data, n);
+		if (calib->ready(zero)) {
+			calibrated(zero);
+			calib.reset();
+		}
+	}
+	if (!n)
 		return;
+
+	clock.observe(data[n - 1].timestamp, host_us);
+	if (shared && clock.synced())
+		shared->clock.store((uint64_t)id << 32 | clock.jitter(), std::memory_order_relaxed);
+
+	while (n) {
+		convert_samples(data, n, batch);
+		for (size_t i = 0; i < batch.n; ++i)
+			batch_ts[i] = clock.map(data[i].timestamp);
+		process_batch();
+		data += batch.n;
+		n -= batch.n;
+	}
+}
+
+void BandInfo::process_batch() noexcept
+{
+	history.push(batch.ts, batch.ch[0], SensorBatch::MAX, batch.n);
+
+	// decimation started under another filter doesn't carry over
+	uint64_t packed = packed_filter();
+	if (packed != raw_filter) {
+		raw_filter = packed;
+		raw_count = 0;
+		std::fill(std::begin(raw_sum), std::end(raw_sum), 0.0f);
 	}
 
-	Vec<int, 3> rot{data.v.gx, data.v.gy, data.v.gz};
+	auto f = unpack_filter(packed);
+	for (size_t i = 0; i < batch.n; ++i) {
+		sample_ts = batch_ts[i];
+		push_raw(i, f);
+		gestures.process(id, history, batch.n - 1 - i, *this);
+	}
+}
 
-	float ts = data.timestamp / 1000000.0;
-	auto ev = std::make_unique<BandInput::BandRawValue>(id, ts);
-	ev->ax = data.v.ax / MAG_1G;
-	ev->ay = data.v.ay / MAG_1G;
-	ev->az = data.v.az / MAG_1G;
-	ev->gx = data.v.gx / ROT_360;
-	ev->gy = data.v.gy / ROT_360;
-	ev->gz = data.v.gz / ROT_360;
-	mgr.push_event(std::move(ev));
+uint64_t BandInfo::packed_filter() const noexcept
+{
+	uint64_t v = filter.load(std::memory_order_relaxed);
+	if (!v)
+		v = mgr.default_filter.load(std::memory_order_relaxed);
+	return v;
+}
 
-	if (ANY(abs(rot) > STABLE_ROT))
+BandInput::EventFilter BandInfo::current_filter() const noexcept
+{
+	return unpack_filter(packed_filter());
+}
+
+void BandInfo::push_raw(size_t i, const BandInput::EventFilter& f) noexcept
+{
+	using Filter = BandInput::EventFilter;
+
+	produced.fetch_add(1, std::memory_order_relaxed);
+
+	bool keep = f.type_mask & Filter::bit(BandInput::EventData::RAW);
+	if (keep) {
+		switch (f.raw) {
+		case Filter::RAW_ALL:
+		case Filter::RAW_LATEST:
+			break;
+		case Filter::RAW_DROP:
+			keep = false;
+			break;
+		case Filter::RAW_AVERAGE:
+			if (!raw_count)
+				std::fill(std::begin(raw_sum), std::end(raw_sum), 0.0f);
+			for (int c = SampleHistory::AX; c <= SampleHistory::GZ; ++c)
+				raw_sum[c] += batch.ch[c][i];
+			keep = ++raw_count >= f.n;
+			break;
+		case Filter::RAW_HEARTBEAT:
+			keep = ++raw_count >= f.n;
+			break;
+		}
+	}
+
+	if (!keep) {
+		filtered.fetch_add(1, std::memory_order_relaxed);
 		return;
+	}
+
+	int64_t ts = batch_ts[i];
+	BandInput::EventRecord rec;
+
+	if (f.raw == Filter::RAW_HEARTBEAT) {
+		::new (static_cast<void *>(&rec)) BandInput::EventData(BandInput::EventData::TIME, id, ts);
+		raw_count = 0;
+	} else if (f.raw == Filter::RAW_AVERAGE) {
+		auto ev = ::new (static_cast<void *>(&rec)) BandInput::BandRawValue(id, ts);
+		float k = 1.0f / raw_count;
+		ev->ax = raw_sum[SampleHistory::AX] * k;
+		ev->ay = raw_sum[SampleHistory::AY] * k;
+		ev->az = raw_sum[SampleHistory::AZ] * k;
+		ev->gx = raw_sum[SampleHistory::GX] * k;
+		ev->gy = raw_sum[SampleHistory::GY] * k;
+		ev->gz = raw_sum[SampleHistory::GZ] * k;
+		raw_count = 0;
+	} else {
+		auto ev = ::new (static_cast<void *>(&rec)) BandInput::BandRawValue(id, ts);
+		ev->ax = batch.ch[SampleHistory::AX][i];
+		ev->ay = batch.ch[SampleHistory::AY][i];
+		ev->az = batch.ch[SampleHistory::AZ][i];
+		ev->gx = batch.ch[SampleHistory::GX][i];
+		ev->gy = batch.ch[SampleHistory::GY][i];
+		ev->gz = batch.ch[SampleHistory::GZ][i];
+
+		// overwrites the sample checkEvents() didn't pick up yet
+		if (f.raw == Filter::RAW_LATEST && shared) {
+			ev->arrival_us = arrival_us;
+			BandLatency::record(id, BandLatency::QUEUED, arrival_us);
+			shared->latest.store(*ev);
+			return;
+		}
+	}
+	queue(rec);
+}
+
+void LatestRaw::store(const BandInput::BandRawValue& v) noexcept
+{
+	unsigned s = seq.load(std::memory_order_relaxed);
+	seq.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	band_id.store(v.band_id, std::memory_order_relaxed);
+	ts.store(v.detection_ts, std::memory_order_relaxed);
+	arrival_us.store(v.arrival_us, std::memory_order_relaxed);
+	ch[SampleHistory::AX].store(v.ax, std::memory_order_relaxed);
+	ch[SampleHistory::AY].store(v.ay, std::memory_order_relaxed);
+	ch[SampleHistory::AZ].store(v.az, std::memory_order_relaxed);
+	ch[SampleHistory::GX].store(v.gx, std::memory_order_relaxed);
+	ch[SampleHistory::GY].store(v.gy, std::memory_order_relaxed);
+	ch[SampleHistory::GZ].store(v.gz, std::memory_order_relaxed);
+
+	seq.store(s + 2, std::memory_order_release);
+}
+
+bool LatestRaw::load(BandInput::BandRawValue& v) noexcept
+{
+	// the producer holds the lock for a few stores only
+	for (int tries = 0; tries < 4; ++tries) {
+		unsigned s = seq.load(std::memory_order_acquire);
+		if (s == emitted)
+			return false;
+		if (s & 1)
+			continue;
+
+		v.band_id = band_id.load(std::memory_order_relaxed);
+		v.detection_ts = ts.load(std::memory_order_relaxed);
+		v.arrival_us = arrival_us.load(std::memory_order_relaxed);
+		v.ax = ch[SampleHistory::AX].load(std::memory_order_relaxed);
+		v.ay = ch[SampleHistory::AY].load(std::memory_order_relaxed);
+		v.az = ch[SampleHistory::AZ].load(std::memory_order_relaxed);
+		v.gx = ch[SampleHistory::GX].load(std::memory_order_relaxed);
+		v.gy = ch[SampleHistory::GY].load(std::memory_order_relaxed);
+		v.gz = ch[SampleHistory::GZ].load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq.load(std::memory_order_relaxed) == s) {
+			emitted = s;
+			return true;
+		}
+	}
+	return false;
+}
+
+void BandInfo::emit(const BandInput::EventRecord& rec) noexcept
+{
+	produced.fetch_add(1, std::memory_order_relaxed);
 
-	double fa = std::abs(std::hypot(data.v.ax, data.v.ay, data.v.az) / MAG_1G) - 1;
-//	std::cerr << "--- fa = " << fa << '\n';
-	if (abs(fa) > STABLE_FORCE_DIFF)
+	if (!(current_filter().type_mask & BandInput::EventFilter::bit(rec.data.type))) {
+		filtered.fetch_add(1, std::memory_order_relaxed);
 		return;
+	}
 
-	float pitch = atan2(data.v.ax, std::hypot(data.v.ay, data.v.az)) * 2 / M_PI;	// 1 is up, -1 is down
+	BandInput::EventRecord copy = rec;
+	queue(copy);
+}
 
-	mgr.push_new_event<BandInput::GesturePitchValue>(id, ts, pitch);
+void BandInfo::queue(BandInput::EventRecord& rec) noexcept
+{
+	rec.data.arrival_us = arrival_us;
+	BandLatency::record(id, BandLatency::QUEUED, arrival_us);
+	evq.push_event(rec);
 }
 
 
+HwBandDevice::HwBandDevice(HwBandInfo& info_, BandDeviceLL *bll)
+	: info(info_)
+{
+	BandDevice::operator=(bll);
+}
+
+void HwBandDevice::device_initialized(const std::string& name, uint64_t ts, const DevIdData& devid) noexcept
+{
+	info.device_initialized(name, ts, devid);
+}
+
+void HwBandDevice::device_removed() noexcept
+{
+	// gone when this returns
+	info.device_removed();
+}
+
+void HwBandDevice::data_received(SensorData data) noexcept
+{
+	info.data_received(data);
+}
+
+HwBandInfo::HwBandInfo(BandInputImpl& mgr_, BandDeviceLL *bll, BandWorkers::Shard *shard_)
+	: BandInfo(mgr_, shard_ ? shard_->queue() : *mgr_.queues.front()), shard(shard_),
+	  device(std::make_unique<HwBandDevice>(*this, bll)), zero_pending(false)
+{
+}
+
+void HwBandInfo::device_initialized(const std::string& name, uint64_t ts, const DevIdData& devid) noexcept
+{
+	if (shard)
+		shard->initialized(this, name, ts, devid);
+	else
+		initialized(name, ts, devid);
+}
+
+void HwBandInfo::device_removed() noexcept
+{
+	// libgameinn is done with the device once its callback returns
+	std::unique_ptr<HwBandDevice> gone;
+	{
+		std::unique_lock<std::mutex> lock(mgr.bands_lock);
+		gone = std::move(device);
+	}
+
+	// the worker drops the processing state after the jobs before
+	if (shard) {
+		shard->removed(this);
+		return;
+	}
+	removed();
+	mgr.remove_band(this);
+}
+
+void HwBandInfo::data_received(SensorData data) noexcept
+{
+	if (zero_pending.exchange(false, std::memory_order_acquire))
+		device->adjust_zero(pending_zero);
+
+	if (shard)
+		shard->sample(this, data);
+	else
+		process_samples(&data, 1);
+}
+
+void HwBandInfo::vibe(uint64_t effect)
+{
+	if (device)
+		device->send_vibe(effect);
+}
+
+void HwBandInfo::calibrated(const SensorValues& zero) noexcept
+{
+	if (!shard) {
+		device->adjust_zero(zero);
+		return;
+	}
+
+	// the device isn't the worker's to use; the I/O thread applies it with the next sample
+	pending_zero = zero;
+	zero_pending.store(true, std::memory_order_release);
+}
+
+// BANDGAME_SYNTH=<params> replaces the devices with simulated bands,
+// BANDGAME_REPLAY=<log>[@speed] with a recorded session
 BandInput& BandInput::getInstance()
 {
 	if (!insys) {
 		std::unique_lock<std::mutex> lock(insys_lock);
-		if (!insys)
-			insys = std::make_unique<BandInputImpl>();
+		if (!insys) {
+			const char *synth = getenv("BANDGAME_SYNTH");
+			if (synth && *synth) {
+				try {
+					insys = create_synth_input(synth);
+				} catch (const std::exception& e) {
+					std::cerr << "band input: can't simulate " << e.what() << '\n';
+				}
+			}
+			const char *replay = getenv("BANDGAME_REPLAY");
+			if (!insys && replay && *replay) {
+				try {
+					insys = create_replay_input(replay);
+				} catch (const std::exception& e) {
+					std::cerr << "band input: can't replay " << e.what() << '\n';
+				}
+			}
+			if (!insys)
+				insys = create_device_input();
+		}
 	}
 
 	return *insys;
 }
 
+// BANDGAME_RECORD=<log> records every band seen by this process,
+// BANDGAME_CALIB=<file> calibrates the bands and keeps their offsets there
 BandInputImpl::BandInputImpl()
+	: default_filter(pack_filter(EventFilter())),
+	  haptics(std::bind(&BandInputImpl::send_vibe, this, std::placeholders::_1, std::placeholders::_2)),
+	  sample_event(nullptr)
+{
+	add_queue();
+
+	const char *record = getenv("BANDGAME_RECORD");
+	if (record && *record) {
+		try {
+			recorder = std::make_unique<BandLogWriter>(record);
+		} catch (const std::exception& e) {
+			std::cerr << "band input: can't record " << e.what() << '\n';
+		}
+	}
+
+	const char *calib = getenv("BANDGAME_CALIB");
+	if (calib && *calib)
+		calibration = std::make_unique<BandCalibration>(calib);
+}
+
+BandInputImpl::~BandInputImpl()
+{
+	for (auto& bs : band_slots)
+		delete bs.load(std::memory_order_relaxed);
+}
+
+BandEventQueue& BandInputImpl::add_queue()
+{
+	queues.push_back(std::make_unique<BandEventQueue>(EVQ_SIZE));
+	return *queues.back();
+}
+
+BandInfo *BandInputImpl::add_band(std::unique_ptr<BandInfo> band)
+{
+	std::unique_lock<std::mutex> lock(bands_lock);
+	BandInfo *p = band.get();
+	unsigned id = bands.insert(std::move(band));
+	if (!id) {
+		std::cerr << "band input: too many bands\n";
+		return nullptr;
+	}
+	p->id = id;
+	BandLatency::added(id);
+
+	size_t slot = SlotMap<BandInfo>::slot_of(id);
+	BandSlot *bs = band_slots[slot].load(std::memory_order_relaxed);
+	if (!bs) {
+		bs = new (std::nothrow) BandSlot;
+		band_slots[slot].store(bs, std::memory_order_release);
+		if (slot >= band_slots_used.load(std::memory_order_relaxed))
+			band_slots_used.store(slot + 1, std::memory_order_release);
+	}
+	// without one, RAW_LATEST samples are queued like RAW_ALL and the clock isn't published
+	p->shared = bs;
+	return p;
+}
+
+void BandInputImpl::remove_band(BandInfo *band)
+{
+	std::unique_ptr<BandInfo> gone;
+	{
+		std::unique_lock<std::mutex> lock(bands_lock);
+		gone = bands.remove(band->id);
+	}
+}
+
+bool BandInputImpl::send_vibe(unsigned id, uint64_t effect)
+{
+	std::unique_lock<std::mutex> lock(bands_lock);
+	BandInfo *band = find_band(id);
+	if (!band)
+		return false;
+
+	band->vibe(effect);
+	BandLatency::hapticSent(id);
+	return true;
+}
+
+std::unique_ptr<BandInputImpl> create_device_input()
+{
+	return std::make_unique<HwBandInput>();
+}
+
+// BANDGAME_IO_WORKERS=<n> processes the bands on n threads instead of the
+// I/O thread, BANDGAME_IO_CPUS=<cpu>,... pins them
+HwBandInput::HwBandInput()
 	: mgr(BandManager::create())
 {
+	const char *nworkers = getenv("BANDGAME_IO_WORKERS");
+	unsigned n = nworkers ? strtoul(nworkers, nullptr, 0) : 0;
+	if (n) {
+		std::vector<int> cpus;
+		const char *cpulist = getenv("BANDGAME_IO_CPUS");
+		if (cpulist) {
+			std::istringstream in(cpulist);
+			std::string cpu;
+			while (std::getline(in, cpu, ','))
+				cpus.push_back(cpu.empty() ? -1 : atoi(cpu.c_str()));
+		}
+		workers = std::make_unique<BandWorkers>(*this, n, cpus);
+	}
+
 	for (auto b : mgr->bands())
 		on_band_found(b);
 
-	mgr->on_new_band = std::bind(&BandInputImpl::on_band_found, this, std::placeholders::_1);
+	mgr->on_new_band = [this] (BandDeviceLL *ll) {
+		on_band_found(ll);
+	};
 
 	iothread = std::thread(std::bind(&BandManager::run, std::ref(*mgr)));
 }
 
-BandInputImpl::~BandInputImpl()
+HwBandInput::~HwBandInput()
 {
+	haptics.stop();
 	mgr->stop();
 	iothread.join();
+	workers.reset();
 }
 
-void BandInputImpl::on_band_found(BandDeviceLL *ll)
+void HwBandInput::on_band_found(BandDeviceLL *ll)
 {
+	BandWorkers::Shard *shard = workers ? &workers->assign() : nullptr;
 	try {
-		bands.emplace(std::make_unique<BandInfo>(*this, ll));
+		if (add_band(std::make_unique<HwBandInfo>(*this, ll, shard)))
+			return;
 	} catch (...) {
 		// TODO
 	}
+	if (shard)
+		workers->release(*shard);
 }
 
-void BandInputImpl::on_band_lost(BandInfo *bandinfo)
+void BandInputImpl::checkEvents(cocos2d::EventDispatcher& evdispatch)
 {
-	bands.erase(bands.find(bandinfo));
+	bool want_samples = evdispatch.hasEventListener(Event::event_name);
+	bool want_batch = evdispatch.hasEventListener(Batch::event_name);
+
+	// drain only what is already queued, so a busy producer can't stall the frame
+	merge_avail.resize(queues.size());
+	for (size_t i = 0; i < queues.size(); ++i) {
+		auto& q = *queues[i];
+		uint64_t lost = q.overflowCount();
+		if (lost != q.lost) {
+			std::cerr << "band input: " << lost - q.lost << " events dropped (queue full)\n";
+			q.lost = lost;
+		}
+		merge_avail[i] = q.readable();
+	}
+
+	// records of several producers go out in timestamp order
+	for (;;) {
+		BandEventQueue *q = nullptr;
+		size_t qi = 0;
+		for (size_t i = 0; i < queues.size(); ++i)
+			if (merge_avail[i] && (!q || queues[i]->front()->data.detection_ts < q->front()->data.detection_ts)) {
+				q = queues[i].get();
+				qi = i;
+			}
+		if (!q)
+			break;
+		--merge_avail[qi];
+
+		deliver(*q->front(), evdispatch, want_samples, want_batch);
+		q->pop();
+	}
+
+	// newest sample of the RAW_LATEST bands, once per frame
+	size_t nslots = band_slots_used.load(std::memory_order_acquire);
+	for (size_t i = 0; i < nslots; ++i) {
+		BandSlot *bs = band_slots[i].load(std::memory_order_acquire);
+		EventRecord rec;
+		auto raw = ::new (static_cast<void *>(&rec)) BandRawValue(0, 0);
+		if (!bs || !bs->latest.load(*raw) || !bands.live(raw->band_id))
+			continue;
+		auto p = batch_index.find(raw->band_id);
+		if (p != batch_index.end() && batch_slots[p->second].removed)
+			continue;
+		deliver(rec, evdispatch, want_samples, want_batch);
+	}
+
+	flush_batch(evdispatch);
 }
 
-void BandInputImpl::on_band_calibrated(BandInfo& band, std::unique_ptr<BandCalibrator> calib)
+void BandInputImpl::deliver(EventRecord& rec, cocos2d::EventDispatcher& evdispatch, bool want_samples, bool want_batch)
 {
-	band.adjust_zero(calib->zero_offset());
+	auto& slot = batch_slot(rec.data.band_id);
+	++slot.delivered;
+	slot.removed |= rec.data.type == EventData::REMOVED;
+	BandLatency::dispatched(rec.data);
+	if (want_samples) {
+		sample_event.rearm(&rec.data);
+		evdispatch.dispatchEvent(&sample_event);
+	}
+	if (want_batch)
+		slot.records.push_back(rec);
 }
 
-void BandInputImpl::checkEvents(cocos2d::EventDispatcher& evdispatch)
+void BandInputImpl::setEventFilter(unsigned band_id, const EventFilter& filter)
 {
-	std::deque<std::unique_ptr<EventData>> q;
+	if (!band_id) {
+		default_filter.store(pack_filter(filter), std::memory_order_relaxed);
+		return;
+	}
 
-	{
-		std::unique_lock<std::mutex> lock(insys_lock);
-		q = std::move(evq);
+	std::unique_lock<std::mutex> lock(bands_lock);
+	BandInfo *band = find_band(band_id);
+	if (band)
+		band->filter.store(pack_filter(filter), std::memory_order_relaxed);
+}
+
+BandInput::Stats BandInputImpl::getStats(unsigned band_id) const
+{
+	Stats st{};
+
+	auto p = batch_index.find(band_id);
+	if (p != batch_index.end())
+		st.delivered = batch_slots[p->second].delivered;
+
+	std::unique_lock<std::mutex> lock(bands_lock);
+	BandInfo *band = find_band(band_id);
+	if (band) {
+		st.produced = band->produced.load(std::memory_order_relaxed);
+		st.filtered = band->filtered.load(std::memory_order_relaxed);
+		st.clock_synced = band->clock.synced();
+		st.clock_offset = band->clock.offset();
+		st.clock_drift = band->clock.drift();
+		st.clock_jitter = band->clock.jitter();
+		st.clock_outliers = band->clock.outliers();
 	}
 
-	for (auto& gest : q)
-		evdispatch.dispatchEvent(Event::create(gest.get()));
+	return st;
+}
+
+bool BandInputImpl::getClockJitter(unsigned band_id, uint32_t& jitter) const
+{
+	size_t slot = SlotMap<BandInfo>::slot_of(band_id);
+	if (slot >= band_slots_used.load(std::memory_order_acquire))
+		return false;
+	BandSlot *bs = band_slots[slot].load(std::memory_order_acquire);
+	uint64_t v = bs ? bs->clock.load(std::memory_order_relaxed) : 0;
+	if (v >> 32 != band_id)
+		return false;
+	jitter = (uint32_t)v;
+	return true;
+}
+
+BandInputImpl::BatchSlot& BandInputImpl::batch_slot(unsigned band_id)
+{
+	auto p = batch_index.emplace(band_id, batch_slots.size());
+	if (p.second)
+		batch_slots.push_back(BatchSlot{band_id, false, 0, {}});
+	return batch_slots[p.first->second];
+}
+
+void BandInputImpl::flush_batch(cocos2d::EventDispatcher& evdispatch)
+{
+	batch_spans.clear();
+	for (auto& slot : batch_slots)
+		if (!slot.records.empty())
+			batch_spans.push_back(EventSpan{slot.band_id, slot.records.data(), slot.records.size()});
+
+	if (!batch_spans.empty()) {
+		batch_event.rearm(batch_spans.data(), batch_spans.size());
+		evdispatch.dispatchEvent(&batch_event);
+	}
+
+	for (size_t i = 0; i < batch_slots.size(); ) {
+		auto& slot = batch_slots[i];
+		if (!slot.removed) {
+			slot.records.clear();
+			++i;
+			continue;
+		}
+
+		// band is gone: drop its slot, keeping the vector dense
+		batch_index.erase(slot.band_id);
+		if (i != batch_slots.size() - 1) {
+			slot = std::move(batch_slots.back());
+			batch_index[slot.band_id] = i;
+		}
+		batch_slots.pop_back();
+	}
 }
 
 BandInfo *BandInputImpl::find_band(unsigned id) const
 {
-	// FIXME: map
-	for (auto& p : bands)
-		if (p->id == id)
-			return p.get();
-	return nullptr;
+	return bands.find(id);
 }
 
-void BandInputImpl::push_event(std::unique_ptr<EventData> ev)
+BandEventQueue::BandEventQueue(size_t capacity)
+	: SpscQueue(capacity), lost(0)
 {
-	std::unique_lock<std::mutex> lock(insys_lock);
-	evq.emplace_back(std::move(ev));
+}
+
+void BandEventQueue::push_event(const BandInput::EventRecord& ev) noexcept
+{
+	bool ctrl = ev.data.type == BandInput::EventData::ADDED || ev.data.type == BandInput::EventData::REMOVED;
+	push(ev, ctrl ? 0 : EVQ_CTRL_RESERVE);
 }
 
 BandInput::Event::Event(EventData *datap)
        	: EventCustom(event_name)
 {
 	setUserData(datap);
-	autorelease();
 }
 
 BandInput::Event *BandInput::Event::create(EventData *datap)
 {
-	return new Event(datap);
+	auto p = new Event(datap);
+	p->autorelease();
+	return p;
+}
+
+BandInput::Batch::Batch()
+	: EventCustom(event_name), spans(nullptr), count(0)
+{
 }
 
-BandInput::VibeAction *BandInput::VibeAction::create(unsigned id, uint64_t effect)
+BandInput::VibeAction *BandInput::VibeAction::create(unsigned id, uint64_t effect, Priority prio)
 {
-	return new VibeActionImpl(id, effect);
+	return new VibeActionImpl(id, effect, prio);
 }
 
-void BandInput::VibeAction::trigger(unsigned id, uint64_t effect)
+void BandInput::VibeAction::trigger(unsigned id, uint64_t effect, Priority prio)
 {
 	auto& in = static_cast<BandInputImpl&>(BandInput::getInstance());
-	std::unique_lock<std::mutex> lock(insys_lock);
-	BandInfo *band = in.find_band(id);
-	if (band) {
-		std::cerr << "band #" << id << " vibe " << std::hex << le64toh(htobe64(effect)) << std::dec << '\n';
-		band->send_vibe(effect);
-	}
+	if (in.bands.live(id))
+		in.haptics.push(id, effect, prio);
+}
+
+void BandInput::VibeAction::playTimeline(unsigned session, std::vector<Cue> cues)
+{
+	auto& in = static_cast<BandInputImpl&>(BandInput::getInstance());
+	in.haptics.play(session, std::move(cues));
+}
+
+void BandInput::VibeAction::cancelTimeline(unsigned session)
+{
+	auto& in = static_cast<BandInputImpl&>(BandInput::getInstance());
+	in.haptics.play(session, {});
 }
 
-VibeActionImpl::VibeActionImpl(unsigned id_, uint64_t effect_)
-	: effect(effect_), id(id_)
+VibeActionImpl::VibeActionImpl(unsigned id_, uint64_t effect_, Priority prio_)
+	: effect(effect_), id(id_), prio(prio_)
 {
 	autorelease();
 }
 
 VibeActionImpl *VibeActionImpl::clone() const
 {
-	return new VibeActionImpl(id, effect);
+	return new VibeActionImpl(id, effect, prio);
 }
 
 VibeActionImpl *VibeActionImpl::reverse() const
@@ -292,13 +841,13 @@ VibeActionImpl *VibeActionImpl::reverse() const
 	uint64_t ne = htobe64(le64toh(effect));
 	if (ne)
 		ne >>= (__builtin_ctz(ne) / 8) * 8;
-	return new VibeActionImpl(id, ne);
+	return new VibeActionImpl(id, ne, prio);
 }
 
 void VibeActionImpl::update(float time)
 {
 	if (time == 1)
-		trigger(id, effect);
+		trigger(id, effect, prio);
 }
 
 BandInputInjector *BandInputInjector::create()
@@ -3,19 +3,23 @@
 
 #include "cocos2d.h"
 
+#include <chrono>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 struct BandInput
 {
 	struct EventData
 	{
-		enum Type { ADDED, REMOVED, RAW, PITCH };
+		enum Type { ADDED, REMOVED, RAW, PITCH, GESTURE, TIME };
 
 		Type type;
 		unsigned band_id;
-		float detection_ts;
+		int64_t detection_ts;	// BandInput::now() time base, band clock mapped onto it
+		uint32_t arrival_us;	// host time the samples arrived, see BandLatency; 0 if not measured
 
-		EventData(Type type_, unsigned id, float ts) : type(type_), band_id(id), detection_ts(ts) {}
+		EventData(Type type_, unsigned id, int64_t ts) : type(type_), band_id(id), detection_ts(ts), arrival_us(0) {}
        	};
 
 	struct BandRawValue : public EventData
@@ -23,14 +27,69 @@ struct BandInput
 		float ax, ay, az;	// [g]
 		float gx, gy, gz;	// [360deg/s]
 
-		BandRawValue(unsigned id, float ts) : EventData(RAW, id, ts) {}
+		BandRawValue(unsigned id, int64_t ts) : EventData(RAW, id, ts) {}
 	};
 
 	struct GesturePitchValue : public EventData
 	{
 		float pitch;
 
-		GesturePitchValue(unsigned id, float ts, float value) : EventData(PITCH, id, ts), pitch(value) {}
+		GesturePitchValue(unsigned id, int64_t ts, float value) : EventData(PITCH, id, ts), pitch(value) {}
+	};
+
+	struct GestureValue : public EventData
+	{
+		enum Kind { SHAKE, TAP, ROTATION, SWING };
+
+		Kind gesture;
+		float value;	// SHAKE, TAP: peak [g]; ROTATION: [turns]; SWING: peak [360deg/s]
+
+		GestureValue(unsigned id, int64_t ts, Kind kind, float value_) : EventData(GESTURE, id, ts), gesture(kind), value(value_) {}
+	};
+
+	// fixed-size record passed between the I/O and cocos threads; tagged by data.type
+	union EventRecord
+	{
+		EventData data;
+		BandRawValue raw;
+		GesturePitchValue pitch;
+		GestureValue gesture;
+
+		EventRecord() {}
+	};
+
+	struct Event;
+
+	// records of a single band collected during one frame, in arrival order
+	struct EventSpan
+	{
+		unsigned band_id;
+		const EventRecord *records;
+		size_t count;
+
+		const EventRecord *begin() const { return records; }
+		const EventRecord *end() const { return records + count; }
+	};
+
+	// one per frame, reused; valid only for the duration of the listener call
+	struct Batch : public cocos2d::EventCustom
+	{
+		const EventSpan *begin() const { return spans; }
+		const EventSpan *end() const { return spans + count; }
+		size_t size() const { return count; }
+	private:
+		friend struct BandInput::Event;
+		friend struct BandInputImpl;
+
+		static const std::string event_name;
+
+		const EventSpan *spans;
+		size_t count;
+
+		Batch();
+		Batch(const Batch& other) = delete;
+
+		void rearm(const EventSpan *spans_, size_t count_) { spans = spans_; count = count_; _isStopped = false; }
 	};
 
 	struct Event : public cocos2d::EventCustom
@@ -42,10 +101,13 @@ struct BandInput
 		bool isBandRemoved() const { return getData().type == EventData::REMOVED; }
 		bool isRawType() const { return getData().type == EventData::RAW; }
 		bool isPitchType() const { return getData().type == EventData::PITCH; }
+		bool isGestureType() const { return getData().type == EventData::GESTURE; }
+		bool isTimeType() const { return getData().type == EventData::TIME; }
 
 		EventData& getData() const { return *reinterpret_cast<EventData *>(getUserData()); }
 		BandRawValue& getRawData() const { return static_cast<BandRawValue&>(getData()); }
 		GesturePitchValue& getPitchData() const { return static_cast<GesturePitchValue&>(getData()); }
+		GestureValue& getGestureData() const { return static_cast<GestureValue&>(getData()); }
 
 		static cocos2d::EventListenerCustom *createListener(std::function<void(Event *)> callback)
 		{
@@ -53,20 +115,47 @@ struct BandInput
 				cb(static_cast<Event *>(e));
 			});
 		}
+
+		// receives all records of a frame at once, grouped per band
+		static cocos2d::EventListenerCustom *createBatchListener(std::function<void(Batch *)> callback)
+		{
+			return cocos2d::EventListenerCustom::create(Batch::event_name, [cb=std::move(callback)] (cocos2d::EventCustom *e) {
+				cb(static_cast<Batch *>(e));
+			});
+		}
 	private:
 		friend class BandInput;
+		friend struct BandInputImpl;
 
 		static const std::string event_name;
 
 		explicit Event(EventData *datap);
 		Event(const Event& other) = delete;
+
+		void rearm(EventData *datap) { setUserData(datap); _isStopped = false; }
 	};
 
 	struct VibeAction : public cocos2d::ActionInstant
 	{
-		static VibeAction *create(unsigned id, uint64_t effect);
+		// FEEDBACK effects are sent ahead of PLAYBACK ones
+		enum Priority { PLAYBACK, FEEDBACK, PRIORITIES };
+
+		static VibeAction *create(unsigned id, uint64_t effect, Priority prio = PLAYBACK);
 
-		static void trigger(unsigned id, uint64_t effect);
+		// queued, sent later from a worker thread; call from the cocos thread
+		static void trigger(unsigned id, uint64_t effect, Priority prio = FEEDBACK);
+
+		struct Cue
+		{
+			uint32_t at_us;		// since the timeline was started
+			unsigned band_id;
+			uint64_t effect;
+		};
+
+		// PLAYBACK effects timed by the worker thread, not by frames; replaces
+		// the running timeline of the same session. Call from the cocos thread.
+		static void playTimeline(unsigned session, std::vector<Cue> cues);
+		static void cancelTimeline(unsigned session);
 
 		static constexpr uint64_t bin4_effect(unsigned val, size_t n)
 		{
@@ -94,10 +183,55 @@ struct BandInput
 		}
 	};
 
+	// applied on the I/O thread, before events are queued
+	struct EventFilter
+	{
+		enum RawPolicy {
+			RAW_ALL,	// every sample
+			RAW_DROP,	// none
+			RAW_LATEST,	// the newest sample, once per checkEvents() call
+			RAW_AVERAGE,	// mean of every n samples
+			RAW_HEARTBEAT,	// TIME record (timestamp only) every n samples
+		};
+
+		static constexpr unsigned bit(EventData::Type t) { return 1u << t; }
+
+		unsigned type_mask = ~0u;	// ADDED and REMOVED are always delivered
+		RawPolicy raw = RAW_ALL;
+		unsigned n = 1;
+	};
+
+	struct Stats
+	{
+		uint64_t produced;	// records generated by the band
+		uint64_t filtered;	// of those, dropped by its EventFilter
+		uint64_t delivered;	// records dispatched by checkEvents()
+
+		// band clock against BandInput::now(), see BandClock
+		bool clock_synced;
+		int64_t clock_offset;	// [us]
+		double clock_drift;	// [ppm]
+		uint32_t clock_jitter;	// [us] samples arrive at most this late after detection_ts
+		uint64_t clock_outliers;	// bursts later than that
+	};
+
 	static BandInput& getInstance();
 
+	// host monotonic time [us]
+	static int64_t now() noexcept
+	{
+		using namespace std::chrono;
+		return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
 	virtual void checkEvents(cocos2d::EventDispatcher&) = 0;
 
+	// band_id 0 sets the filter of bands that have none of their own
+	virtual void setEventFilter(unsigned band_id, const EventFilter& filter) = 0;
+	virtual Stats getStats(unsigned band_id) const = 0;
+	// Stats::clock_jitter without locking, for every frame; false until the band's clock is synced
+	virtual bool getClockJitter(unsigned band_id, uint32_t& jitter) const = 0;
+
 	virtual ~BandInput() = default;
 protected:
 	BandInput();
@@ -0,0 +1,202 @@
+#ifndef BANDGAME_INPUT_IMPL_H_
+#define BANDGAME_INPUT_IMPL_H_
+
+// Internals shared by the BandInput backends.
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "band.h"
+#include "BandCalibration.h"
+#include "BandClock.h"
+#include "BandGestures.h"
+#include "BandHaptics.h"
+#include "BandHistory.h"
+#include "BandInput.h"
+#include "SensorConvert.h"
+#include "SlotMap.h"
+#include "SpscQueue.h"
+
+class BandLogWriter;
+struct BandInputImpl;
+
+static inline uint64_t host_time_us() noexcept
+{
+	return BandInput::now();
+}
+
+// Events of the bands fed by one producer thread.
+struct BandEventQueue : public SpscQueue<BandInput::EventRecord>
+{
+	uint64_t lost;	// overflows already reported, cocos thread only
+
+	explicit BandEventQueue(size_t capacity);
+
+	// keeps some room for ADDED/REMOVED
+	void push_event(const BandInput::EventRecord& ev) noexcept;
+
+	template <typename T, typename... Args>
+	void push_new_event(Args&&... args) noexcept
+	{
+		BandInput::EventRecord rec;
+		::new (static_cast<void *>(&rec)) T(std::forward<Args>(args)...);
+		push_event(rec);
+	}
+};
+
+// Newest RAW sample of a band under RAW_LATEST: a seqlock its producer
+// overwrites and checkEvents() reads once per frame.
+struct LatestRaw
+{
+	std::atomic<unsigned> seq{0};	// odd while written
+	std::atomic<unsigned> band_id{0};
+	std::atomic<int64_t> ts{0};
+	std::atomic<uint32_t> arrival_us{0};
+	std::atomic<float> ch[SampleHistory::GZ + 1];
+	unsigned emitted = 0;	// cocos thread only: seq last delivered
+
+	// producer thread
+	void store(const BandInput::BandRawValue& v) noexcept;
+	// false while written, or if nothing new was stored since the last load
+	bool load(BandInput::BandRawValue& v) noexcept;
+};
+
+// What a band's producer publishes to the cocos thread. Kept per registry
+// slot by BandInputImpl, so it outlives the bands using it and is read
+// without bands_lock.
+struct BandSlot
+{
+	LatestRaw latest;
+	std::atomic<uint64_t> clock{0};	// band id << 32 | jitter [us] once its clock is synced
+};
+
+// Processing pipeline of one band, whatever feeds it with samples.
+// All methods but vibe() are called from the backend's producer thread.
+struct BandInfo : public GestureEmitter
+{
+	BandInputImpl& mgr;
+	BandEventQueue& evq;
+	unsigned id;	// set by BandInputImpl::add_band()
+	std::string my_name;
+
+	std::shared_ptr<BandCalibration::Job> calib;	// until the zero offset is known
+	BandClock clock;
+	SampleHistory history;
+	GestureEngine gestures;
+
+	std::atomic<uint64_t> filter;
+	std::atomic<uint64_t> produced, filtered;
+	BandSlot *shared;	// set by BandInputImpl::add_band()
+
+	BandInfo(BandInputImpl&, BandEventQueue&);
+	virtual ~BandInfo();
+
+	void initialized(const std::string& name, uint64_t ts, const DevIdData& devid) noexcept;
+	// queues REMOVED; the backend drops the band afterwards
+	void removed() noexcept;
+	void process_samples(const SensorData *data, size_t n) noexcept;
+
+	// called from the haptic worker with BandInputImpl::bands_lock held
+	virtual void vibe(uint64_t effect) = 0;
+
+	virtual void emit(const BandInput::EventRecord& rec) noexcept override;
+protected:
+	// on the producer thread
+	virtual void calibrated(const SensorValues&) noexcept {}
+private:
+	SensorBatch batch;
+	int64_t batch_ts[SensorBatch::MAX];	// host time of the batch samples
+	uint32_t arrival_us;
+
+	// RAW decimation state
+	uint64_t raw_filter;	// packed filter the state below was built under
+	unsigned raw_count;
+	float raw_sum[SampleHistory::GZ + 1];
+
+	uint64_t packed_filter() const noexcept;
+	BandInput::EventFilter current_filter() const noexcept;
+	void push_raw(size_t i, const BandInput::EventFilter& f) noexcept;
+	void queue(BandInput::EventRecord& rec) noexcept;
+	void process_batch() noexcept;
+};
+
+struct BandInputImpl : public BandInput
+{
+	// writers and dereferencing readers hold bands_lock; bands.live() doesn't need it
+	mutable std::mutex bands_lock;
+	SlotMap<BandInfo> bands;
+
+	// queues.front() is created with the backend, more are added before their producers start
+	std::vector<std::unique_ptr<BandEventQueue>> queues;
+
+	std::atomic<uint64_t> default_filter;
+
+	// per registry slot, created by add_band() and kept until the end
+	std::atomic<BandSlot *> band_slots[SlotMap<BandInfo>::CAPACITY] = {};
+	std::atomic<size_t> band_slots_used{0};
+
+	// set up before any band exists; written from the producer thread
+	std::unique_ptr<BandLogWriter> recorder;
+	std::unique_ptr<BandCalibration> calibration;
+
+	// backends stop it before tearing down their bands
+	HapticQueue haptics;
+
+	// cocos thread only: reused dispatch state
+	struct BatchSlot
+	{
+		unsigned band_id;
+		bool removed;
+		uint64_t delivered;
+		std::vector<EventRecord> records;
+	};
+
+	Event sample_event;
+	Batch batch_event;
+	std::vector<BatchSlot> batch_slots;
+	std::unordered_map<unsigned, size_t> batch_index;
+	std::vector<EventSpan> batch_spans;
+	std::vector<size_t> merge_avail;	// per queue, records left to deliver this frame
+
+	BandInputImpl();
+	virtual ~BandInputImpl();
+
+	virtual void checkEvents(cocos2d::EventDispatcher&);
+	virtual void setEventFilter(unsigned band_id, const EventFilter& filter);
+	virtual Stats getStats(unsigned band_id) const;
+	virtual bool getClockJitter(unsigned band_id, uint32_t& jitter) const;
+
+	BatchSlot& batch_slot(unsigned band_id);
+	void deliver(EventRecord& rec, cocos2d::EventDispatcher& evdispatch, bool want_samples, bool want_batch);
+	void flush_batch(cocos2d::EventDispatcher& evdispatch);
+
+	BandEventQueue& add_queue();
+
+	// null when the registry is full
+	BandInfo *add_band(std::unique_ptr<BandInfo> band);
+	void remove_band(BandInfo *band);
+
+	// caller holds bands_lock
+	BandInfo *find_band(unsigned id) const;
+
+	// HapticQueue sender
+	bool send_vibe(unsigned id, uint64_t effect);
+};
+
+// libgameinn devices
+std::unique_ptr<BandInputImpl> create_device_input();
+
+// "<log>[@speed]" where speed is a multiplier or "max"; throws if the log can't be read
+std::unique_ptr<BandInputImpl> create_replay_input(const std::string& spec);
+
+// "key=value,..." with keys bands, threads, rate, burst, gestures, noise, seed; throws on a bad spec
+std::unique_ptr<BandInputImpl> create_synth_input(const std::string& spec);
+
+#endif /* BANDGAME_INPUT_IMPL_H_ */
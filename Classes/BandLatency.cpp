@@ -0,0 +1,314 @@
+#include "BandLatency.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "base/CCConsole.h"
+
+namespace {
+
+static constexpr unsigned SUB_BITS = 4;
+static constexpr unsigned SUB = 1u << SUB_BITS;
+static constexpr unsigned BUCKETS = (32 - SUB_BITS + 1) * SUB;
+static constexpr unsigned MAX_BANDS = 65536;	// indexed by the registry slot of a band id, see SlotMap
+static constexpr size_t FRAME_MARKS = 256;
+
+static const char *const stage_name[] = { "queued", "dispatched", "consumed", "displayed", "haptic" };
+static constexpr double PERCENTILES[] = { 50, 90, 99, 99.9 };
+
+// log-linear buckets, at most 1/SUB relative error
+struct Histogram
+{
+	std::atomic<uint32_t> buckets[BUCKETS];
+	std::atomic<uint32_t> max;
+
+	Histogram() { clear(); }
+
+	static unsigned index(uint32_t v) noexcept
+	{
+		if (v < SUB)
+			return v;
+		unsigned msb = 31 - __builtin_clz(v);
+		return (msb - SUB_BITS + 1) * SUB + ((v >> (msb - SUB_BITS)) & (SUB - 1));
+	}
+
+	static uint32_t lower(unsigned i) noexcept
+	{
+		unsigned r = i / SUB, s = i % SUB;
+		return r ? (SUB + s) << (r - 1) : s;
+	}
+
+	void add(uint32_t v) noexcept
+	{
+		buckets[index(v)].fetch_add(1, std::memory_order_relaxed);
+		uint32_t m = max.load(std::memory_order_relaxed);
+		while (v > m && !max.compare_exchange_weak(m, v, std::memory_order_relaxed))
+			;
+	}
+
+	void clear() noexcept
+	{
+		for (auto& b : buckets)
+			b.store(0, std::memory_order_relaxed);
+		max.store(0, std::memory_order_relaxed);
+	}
+};
+
+struct BandHistograms
+{
+	Histogram stages[BandLatency::STAGES];
+	std::atomic<uint32_t> last_consumed;
+	std::atomic<unsigned> band_id;	// full id, generation included
+
+	explicit BandHistograms(unsigned id) : last_consumed(0), band_id(id) {}
+
+	void clear() noexcept
+	{
+		for (auto& s : stages)
+			s.clear();
+		last_consumed.store(0, std::memory_order_relaxed);
+	}
+};
+
+struct FrameMark
+{
+	unsigned frame;
+	uint32_t begin_us, end_us;
+	unsigned events;
+};
+
+struct State
+{
+	std::atomic<bool> enabled{false};
+	std::atomic<BandHistograms *> bands[MAX_BANDS] = {};
+
+	// cocos thread only
+	std::vector<std::pair<unsigned, uint32_t>> pending;	// dispatched this frame
+	bool frames = false;
+	FrameMark marks[FRAME_MARKS] = {};
+	unsigned frame = 0;
+	uint32_t frame_begin = 0;
+};
+
+State& state()
+{
+	static State s;
+	return s;
+}
+
+// null if the slot belongs to another band
+BandHistograms *find(unsigned band_id, bool create) noexcept
+{
+	auto& slot = state().bands[band_id % MAX_BANDS];
+	BandHistograms *h = slot.load(std::memory_order_acquire);
+	if (!h && create) {
+		auto *fresh = new (std::nothrow) BandHistograms(band_id);
+		if (!fresh)
+			return nullptr;
+		if (slot.compare_exchange_strong(h, fresh, std::memory_order_acq_rel))
+			return fresh;
+		delete fresh;
+	}
+	return h && h->band_id.load(std::memory_order_acquire) == band_id ? h : nullptr;
+}
+
+void print_histogram(std::ostream& out, unsigned band_id, int stage, const Histogram& h)
+{
+	uint32_t counts[BUCKETS];
+	uint64_t total = 0;
+	for (unsigned i = 0; i < BUCKETS; ++i)
+		total += counts[i] = h.buckets[i].load(std::memory_order_relaxed);
+	if (!total)
+		return;
+
+	out << "band " << band_id << ' ' << std::setw(10) << std::left << stage_name[stage] << std::right
+	    << " n " << std::setw(8) << total;
+
+	uint64_t seen = 0;
+	unsigned i = 0;
+	for (double p : PERCENTILES) {
+		uint64_t rank = (uint64_t)(total * p / 100);
+		while (i < BUCKETS - 1 && seen + counts[i] <= rank)
+			seen += counts[i++];
+		out << "  p" << p << ' ' << std::setw(7) << Histogram::lower(i);
+	}
+	out << "  max " << h.max.load(std::memory_order_relaxed) << " us\n";
+}
+
+void console_command(int fd, const std::string& args)
+{
+	std::istringstream in(args);
+	std::string cmd, arg;
+	in >> cmd >> arg;
+
+	if (cmd == "on" || cmd == "off") {
+		BandLatency::setEnabled(cmd == "on");
+		return;
+	}
+
+	// reading the frame markers is only safe from the cocos thread
+	auto sched = cocos2d::Director::getInstance()->getScheduler();
+	if (cmd == "reset") {
+		sched->performFunctionInCocosThread(BandLatency::reset);
+	} else if (cmd == "save" && !arg.empty()) {
+		sched->performFunctionInCocosThread([fd, arg] {
+			if (!BandLatency::save(arg))
+				cocos2d::Console::Utility::mydprintf(fd, "can't write %s\n", arg.c_str());
+		});
+	} else if (cmd.empty() || cmd == "dump") {
+		sched->performFunctionInCocosThread([fd] {
+			std::ostringstream out;
+			BandLatency::dump(out);
+			cocos2d::Console::Utility::mydprintf(fd, "%s", out.str().c_str());
+			cocos2d::Console::Utility::sendPrompt(fd);
+		});
+	} else {
+		cocos2d::Console::Utility::mydprintf(fd, "usage: latency [on|off|dump|reset|save <file>]\n");
+	}
+}
+
+} /* namespace */
+
+uint32_t BandLatency::now() noexcept
+{
+	using namespace std::chrono;
+	static const auto epoch = steady_clock::now();
+	uint32_t t = duration_cast<microseconds>(steady_clock::now() - epoch).count();
+	return t ? t : 1;
+}
+
+bool BandLatency::enabled() noexcept
+{
+	return state().enabled.load(std::memory_order_relaxed);
+}
+
+void BandLatency::setEnabled(bool on) noexcept
+{
+	state().enabled.store(on, std::memory_order_relaxed);
+}
+
+void BandLatency::reset() noexcept
+{
+	for (auto& slot : state().bands) {
+		BandHistograms *h = slot.load(std::memory_order_acquire);
+		if (h)
+			h->clear();
+	}
+}
+
+void BandLatency::added(unsigned band_id) noexcept
+{
+	// histograms are created on the first record; those of the slot's
+	// previous band stop taking records before they are cleared
+	BandHistograms *h = state().bands[band_id % MAX_BANDS].load(std::memory_order_acquire);
+	if (h && h->band_id.load(std::memory_order_relaxed) != band_id) {
+		h->band_id.store(band_id, std::memory_order_release);
+		h->clear();
+	}
+}
+
+void BandLatency::record(unsigned band_id, Stage stage, uint32_t arrival_us) noexcept
+{
+	if (!arrival_us || !enabled())
+		return;
+
+	BandHistograms *h = find(band_id, true);
+	if (h)
+		h->stages[stage].add(now() - arrival_us);
+}
+
+void BandLatency::dispatched(const BandInput::EventData& ev) noexcept
+{
+	if (!ev.arrival_us)
+		return;
+
+	record(ev.band_id, DISPATCHED, ev.arrival_us);
+
+	auto& s = state();
+	if (s.frames)
+		s.pending.emplace_back(ev.band_id, ev.arrival_us);
+}
+
+void BandLatency::consumed(const BandInput::EventData& ev) noexcept
+{
+	if (!ev.arrival_us)
+		return;
+
+	record(ev.band_id, CONSUMED, ev.arrival_us);
+
+	BandHistograms *h = find(ev.band_id, false);
+	if (h)
+		h->last_consumed.store(ev.arrival_us, std::memory_order_relaxed);
+}
+
+void BandLatency::hapticSent(unsigned band_id) noexcept
+{
+	BandHistograms *h = find(band_id, false);
+	if (h)
+		record(band_id, HAPTIC, h->last_consumed.load(std::memory_order_relaxed));
+}
+
+void BandLatency::attach(cocos2d::Director& director)
+{
+	auto& s = state();
+	s.frames = true;
+
+	const char *env = getenv("BANDGAME_LATENCY");
+	if (env && *env && *env != '0')
+		setEnabled(true);
+
+	auto evd = director.getEventDispatcher();
+	evd->addCustomEventListener(cocos2d::Director::EVENT_BEFORE_DRAW, [&s] (cocos2d::EventCustom *) {
+		s.frame_begin = now();
+	});
+	evd->addCustomEventListener(cocos2d::Director::EVENT_AFTER_DRAW, [&s] (cocos2d::EventCustom *) {
+		uint32_t t = now();
+		s.marks[s.frame % FRAME_MARKS] = FrameMark{s.frame, s.frame_begin, t, (unsigned)s.pending.size()};
+		++s.frame;
+
+		for (auto& p : s.pending)
+			record(p.first, DISPLAYED, p.second);
+		s.pending.clear();
+	});
+
+	auto console = director.getConsole();
+	if (console)
+		console->addCommand({"latency", "Band latency histograms. Args: [on|off|dump|reset|save <file>]", console_command});
+}
+
+void BandLatency::dump(std::ostream& out)
+{
+	auto& s = state();
+
+	out << "# band latency [us] since sample arrival, " << (enabled() ? "enabled" : "disabled") << '\n';
+	for (unsigned i = 0; i < MAX_BANDS; ++i) {
+		BandHistograms *h = s.bands[i].load(std::memory_order_acquire);
+		if (!h)
+			continue;
+		unsigned id = h->band_id.load(std::memory_order_relaxed);
+		for (int st = 0; st < STAGES; ++st)
+			print_histogram(out, id, st, h->stages[st]);
+	}
+
+	out << "# frame begin_us end_us events\n";
+	unsigned n = std::min<unsigned>(s.frame, FRAME_MARKS);
+	for (unsigned f = s.frame - n; f != s.frame; ++f) {
+		auto& m = s.marks[f % FRAME_MARKS];
+		out << "frame " << m.frame << ' ' << m.begin_us << ' ' << m.end_us << ' ' << m.events << '\n';
+	}
+}
+
+bool BandLatency::save(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+	dump(out);
+	return bool(out.flush());
+}
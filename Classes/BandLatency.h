@@ -0,0 +1,53 @@
+#ifndef BANDGAME_LATENCY_H_
+#define BANDGAME_LATENCY_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "BandInput.h"
+
+// Per-band latency histograms. Every stage is measured from the host time
+// the band's samples arrived (EventData::arrival_us), so the stages add up
+// to the motion-to-feedback latency. Recording is lock-free and off by
+// default; BANDGAME_LATENCY=1 or the "latency on" console command enable it.
+class BandLatency
+{
+public:
+	enum Stage {
+		QUEUED,		// record pushed by the I/O thread
+		DISPATCHED,	// handed to listeners by checkEvents()
+		CONSUMED,	// used by the game, see consumed()
+		DISPLAYED,	// end of the frame that dispatched it
+		HAPTIC,		// vibe sent, since the last consumed record of the band
+		STAGES
+	};
+
+	// host time base of arrival_us; never 0, which marks unstamped records
+	static uint32_t now() noexcept;
+
+	static bool enabled() noexcept;
+	static void setEnabled(bool on) noexcept;
+	static void reset() noexcept;
+
+	static void record(unsigned band_id, Stage stage, uint32_t arrival_us) noexcept;
+
+	// a band got the id; drops the histograms of the band that had its registry slot before
+	static void added(unsigned band_id) noexcept;
+
+	// cocos thread
+	static void dispatched(const BandInput::EventData& ev) noexcept;
+	static void consumed(const BandInput::EventData& ev) noexcept;
+
+	// any thread, after the vibe request reached the device
+	static void hapticSent(unsigned band_id) noexcept;
+
+	// frame markers around Director::drawScene and the "latency" console command
+	static void attach(cocos2d::Director& director);
+
+	// percentiles per band and stage, followed by the recent frame markers
+	static void dump(std::ostream& out);
+	static bool save(const std::string& path);
+};
+
+#endif /* BANDGAME_LATENCY_H_ */
@@ -0,0 +1,284 @@
+#include "BandLog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char LOG_MAGIC[8] = { 'B', 'N', 'D', 'L', 'O', 'G', '0', '1' };
+static constexpr size_t LOG_CHUNK = 1 << 20;
+static constexpr size_t MAX_RECORD_HEAD = 1 + 3 * 10;	// tag, host delta, band
+
+static uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+	while (v >= 0x80) {
+		*p++ = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t& v)
+{
+	v = 0;
+	for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+		uint8_t b = *p++;
+		v |= (uint64_t)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+BandLogWriter::BandLogWriter(const std::string& path)
+	: map(nullptr), map_size(0), pos(0), last_host_us(0)
+{
+	fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), path);
+
+	uint8_t *p = reserve(sizeof(LOG_MAGIC));
+	if (!p) {
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), path);
+	}
+	memcpy(p, LOG_MAGIC, sizeof(LOG_MAGIC));
+	pos += sizeof(LOG_MAGIC);
+}
+
+BandLogWriter::~BandLogWriter()
+{
+	if (map)
+		munmap(map, map_size);
+	if (ftruncate(fd, pos))
+		std::cerr << "band log: can't trim the file: " << strerror(errno) << std::endl;
+	close(fd);
+}
+
+uint8_t *BandLogWriter::reserve(size_t n) noexcept
+{
+	if (pos + n <= map_size)
+		return map + pos;
+
+	size_t size = map_size ? map_size : LOG_CHUNK;
+	while (size < pos + n)
+		size *= 2;
+
+	if (ftruncate(fd, size))
+		return nullptr;
+
+	void *p = map ? mremap(map, map_size, size, MREMAP_MAYMOVE)
+		      : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+	map = static_cast<uint8_t *>(p);
+	map_size = size;
+	return map + pos;
+}
+
+uint8_t *BandLogWriter::begin_record(int tag, uint64_t host_us, unsigned band, size_t payload) noexcept
+{
+	uint8_t *p = reserve(MAX_RECORD_HEAD + payload);
+	if (!p)
+		return nullptr;
+
+	// the first record starts the log's time base
+	if (pos == sizeof(LOG_MAGIC))
+		last_host_us = host_us;
+
+	*p++ = tag;
+	p = put_varint(p, host_us > last_host_us ? host_us - last_host_us : 0);
+	p = put_varint(p, band);
+	if (host_us > last_host_us)
+		last_host_us = host_us;
+	return p;
+}
+
+void BandLogWriter::arrival(unsigned band, uint64_t host_us, const std::string& name, uint64_t ts, const DevIdData& devid) noexcept
+{
+	std::unique_lock<std::mutex> guard(lock);
+	uint8_t *p = begin_record(BandLogReader::Record::ARRIVAL, host_us, band, 6 * 10 + name.size());
+	if (!p)
+		return;
+
+	p = put_varint(p, name.size());
+	memcpy(p, name.data(), name.size());
+	p += name.size();
+	p = put_varint(p, ts);
+	p = put_varint(p, devid.registry);
+	p = put_varint(p, devid.vendor);
+	p = put_varint(p, devid.product);
+	p = put_varint(p, devid.version);
+	pos = p - map;
+
+	prev[band] = SensorData();
+}
+
+void BandLogWriter::removal(unsigned band, uint64_t host_us) noexcept
+{
+	std::unique_lock<std::mutex> guard(lock);
+	uint8_t *p = begin_record(BandLogReader::Record::REMOVAL, host_us, band, 0);
+	if (!p)
+		return;
+
+	pos = p - map;
+	prev.erase(band);
+}
+
+void BandLogWriter::samples(unsigned band, uint64_t host_us, const SensorData *data, size_t n) noexcept
+{
+	std::unique_lock<std::mutex> guard(lock);
+	SensorData& last = prev[band];
+
+	for (size_t i = 0; i < n; ++i, host_us = last_host_us) {
+		const SensorData& d = data[i];
+		uint8_t *p = begin_record(BandLogReader::Record::SAMPLE, host_us, band, 7 * 10);
+		if (!p)
+			return;
+
+		p = put_varint(p, zigzag((int64_t)d.timestamp - (int64_t)last.timestamp));
+		p = put_varint(p, zigzag((int64_t)d.v.ax - last.v.ax));
+		p = put_varint(p, zigzag((int64_t)d.v.ay - last.v.ay));
+		p = put_varint(p, zigzag((int64_t)d.v.az - last.v.az));
+		p = put_varint(p, zigzag((int64_t)d.v.gx - last.v.gx));
+		p = put_varint(p, zigzag((int64_t)d.v.gy - last.v.gy));
+		p = put_varint(p, zigzag((int64_t)d.v.gz - last.v.gz));
+		pos = p - map;
+
+		last = d;
+	}
+}
+
+BandLogReader::BandLogReader(const std::string& path)
+	: map(nullptr), map_size(0), host_us(0)
+{
+	fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), path);
+
+	struct stat st;
+	if (fstat(fd, &st)) {
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), path);
+	}
+
+	map_size = st.st_size;
+	if (map_size < sizeof(LOG_MAGIC)) {
+		close(fd);
+		throw std::runtime_error(path + ": not a band log");
+	}
+
+	void *p = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), path);
+	}
+
+	map = static_cast<const uint8_t *>(p);
+	end = map + map_size;
+	if (memcmp(map, LOG_MAGIC, sizeof(LOG_MAGIC))) {
+		munmap(const_cast<uint8_t *>(map), map_size);
+		close(fd);
+		throw std::runtime_error(path + ": not a band log");
+	}
+
+	madvise(const_cast<uint8_t *>(map), map_size, MADV_SEQUENTIAL);
+	rewind();
+}
+
+BandLogReader::~BandLogReader()
+{
+	munmap(const_cast<uint8_t *>(map), map_size);
+	close(fd);
+}
+
+void BandLogReader::rewind()
+{
+	cur = map + sizeof(LOG_MAGIC);
+	host_us = 0;
+	prev.clear();
+}
+
+bool BandLogReader::next(Record& rec)
+{
+	if (cur == end)
+		return false;
+
+	const uint8_t *p = cur;
+	uint64_t dt, band;
+	int tag = *p++;
+	if (!get_varint(p, end, dt) || !get_varint(p, end, band))
+		return false;
+
+	rec.type = (Record::Type)tag;
+	rec.band = band;
+	// logs written before the writer seeded its time base store absolute
+	// time in the first record
+	rec.host_us = cur == map + sizeof(LOG_MAGIC) ? 0 : host_us + dt;
+
+	switch (tag) {
+	case Record::ARRIVAL: {
+		uint64_t len, f[5];
+		if (!get_varint(p, end, len) || (uint64_t)(end - p) < len)
+			return false;
+		rec.name.assign(reinterpret_cast<const char *>(p), len);
+		p += len;
+		for (auto& v : f)
+			if (!get_varint(p, end, v))
+				return false;
+		rec.ts = f[0];
+		rec.devid.registry = f[1];
+		rec.devid.vendor = f[2];
+		rec.devid.product = f[3];
+		rec.devid.version = f[4];
+		prev[band] = SensorData();
+		break;
+	}
+	case Record::REMOVAL:
+		prev.erase(band);
+		break;
+	case Record::SAMPLE: {
+		uint64_t f[7];
+		for (auto& v : f)
+			if (!get_varint(p, end, v))
+				return false;
+		SensorData& last = prev[band];
+		last.timestamp += unzigzag(f[0]);
+		last.v.ax += unzigzag(f[1]);
+		last.v.ay += unzigzag(f[2]);
+		last.v.az += unzigzag(f[3]);
+		last.v.gx += unzigzag(f[4]);
+		last.v.gy += unzigzag(f[5]);
+		last.v.gz += unzigzag(f[6]);
+		rec.sample = last;
+		break;
+	}
+	default:
+		return false;
+	}
+
+	cur = p;
+	host_us = rec.host_us;
+	return true;
+}
@@ -0,0 +1,73 @@
+#ifndef BANDGAME_LOG_H_
+#define BANDGAME_LOG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "band.h"
+
+// Compact memory-mapped log of band arrivals, removals and sensor samples.
+// Every record starts with a tag and the host time since the previous record;
+// sample timestamps and axes are zigzag varints, delta-encoded per band.
+// The writer may be shared by several producer threads.
+class BandLogWriter
+{
+	std::mutex lock;
+	int fd;
+	uint8_t *map;
+	size_t map_size, pos;
+	uint64_t last_host_us;
+	std::unordered_map<unsigned, SensorData> prev;
+
+	uint8_t *reserve(size_t n) noexcept;
+	uint8_t *begin_record(int tag, uint64_t host_us, unsigned band, size_t payload) noexcept;
+public:
+	// throws std::system_error when the file can't be created
+	explicit BandLogWriter(const std::string& path);
+	~BandLogWriter();
+
+	BandLogWriter(const BandLogWriter&) = delete;
+	BandLogWriter& operator=(const BandLogWriter&) = delete;
+
+	void arrival(unsigned band, uint64_t host_us, const std::string& name, uint64_t ts, const DevIdData& devid) noexcept;
+	void removal(unsigned band, uint64_t host_us) noexcept;
+	void samples(unsigned band, uint64_t host_us, const SensorData *data, size_t n) noexcept;
+};
+
+class BandLogReader
+{
+	int fd;
+	const uint8_t *map, *cur, *end;
+	size_t map_size;
+	uint64_t host_us;
+	std::unordered_map<unsigned, SensorData> prev;
+public:
+	struct Record
+	{
+		enum Type { ARRIVAL = 1, REMOVAL, SAMPLE };
+
+		Type type;
+		unsigned band;		// as recorded
+		uint64_t host_us;	// since the start of the log
+		std::string name;	// ARRIVAL
+		uint64_t ts;		// ARRIVAL
+		DevIdData devid;	// ARRIVAL
+		SensorData sample;	// SAMPLE
+	};
+
+	// throws std::system_error when the file can't be opened, std::runtime_error when it isn't a band log
+	explicit BandLogReader(const std::string& path);
+	~BandLogReader();
+
+	BandLogReader(const BandLogReader&) = delete;
+	BandLogReader& operator=(const BandLogReader&) = delete;
+
+	// false at the end of the log or on a truncated record
+	bool next(Record& rec);
+	void rewind();
+};
+
+#endif /* BANDGAME_LOG_H_ */
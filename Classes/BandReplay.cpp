@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BandInputImpl.h"
+#include "BandLog.h"
+
+namespace {
+
+struct ReplayBandInfo final : public BandInfo
+{
+	explicit ReplayBandInfo(BandInputImpl& mgr_)
+		: BandInfo(mgr_, *mgr_.queues.front())
+	{
+	}
+
+	virtual void vibe(uint64_t) override {}
+};
+
+// Feeds a recorded session through the regular band pipeline. At speed 0
+// ("max") records are not paced, the replay only waits for the queue to drain.
+class ReplayBandInput final : public BandInputImpl
+{
+	BandLogReader log;
+	double speed;
+
+	std::mutex wait_lock;
+	std::condition_variable wake;
+	bool stopping;
+	std::thread thread;
+
+	// recorded band id -> replayed band
+	std::unordered_map<unsigned, BandInfo *> replayed;
+
+	bool wait_until(std::chrono::steady_clock::time_point t);
+	void flush(unsigned band, std::vector<SensorData>& samples);
+	void run();
+public:
+	ReplayBandInput(const std::string& path, double speed_);
+	virtual ~ReplayBandInput();
+};
+
+ReplayBandInput::ReplayBandInput(const std::string& path, double speed_)
+	: log(path), speed(speed_), stopping(false)
+{
+	thread = std::thread(&ReplayBandInput::run, this);
+}
+
+ReplayBandInput::~ReplayBandInput()
+{
+	{
+		std::unique_lock<std::mutex> lock(wait_lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+// false once stopping
+bool ReplayBandInput::wait_until(std::chrono::steady_clock::time_point t)
+{
+	std::unique_lock<std::mutex> lock(wait_lock);
+	wake.wait_until(lock, t, [this] { return stopping; });
+	return !stopping;
+}
+
+void ReplayBandInput::flush(unsigned band, std::vector<SensorData>& samples)
+{
+	if (samples.empty())
+		return;
+
+	auto p = replayed.find(band);
+	if (p != replayed.end())
+		p->second->process_samples(samples.data(), samples.size());
+	samples.clear();
+}
+
+void ReplayBandInput::run()
+{
+	using namespace std::chrono;
+
+	auto start = steady_clock::now();
+	BandLogReader::Record rec;
+	std::vector<SensorData> burst;
+	unsigned burst_band = 0;
+	uint64_t burst_us = 0;
+	uint64_t records = 0;
+
+	while (log.next(rec)) {
+		++records;
+
+		// samples of one band arriving together are processed as one burst
+		if (rec.type == BandLogReader::Record::SAMPLE && rec.band == burst_band &&
+		    (rec.host_us == burst_us || !speed) && burst.size() < SensorBatch::MAX) {
+			burst.push_back(rec.sample);
+			continue;
+		}
+		flush(burst_band, burst);
+
+		if (speed) {
+			if (!wait_until(start + microseconds((uint64_t)(rec.host_us / speed))))
+				return;
+		} else {
+			auto& q = *queues.front();
+			while (q.writable() < q.capacity() / 2)
+				if (!wait_until(steady_clock::now() + milliseconds(1)))
+					return;
+		}
+
+		switch (rec.type) {
+		case BandLogReader::Record::ARRIVAL: {
+			auto band = add_band(std::make_unique<ReplayBandInfo>(*this));
+			if (!band)
+				break;
+			replayed[rec.band] = band;
+			band->initialized(rec.name, rec.ts, rec.devid);
+			break;
+		}
+		case BandLogReader::Record::REMOVAL: {
+			auto p = replayed.find(rec.band);
+			if (p != replayed.end()) {
+				p->second->removed();
+				remove_band(p->second);
+				replayed.erase(p);
+			}
+			break;
+		}
+		case BandLogReader::Record::SAMPLE:
+			burst_band = rec.band;
+			burst_us = rec.host_us;
+			burst.push_back(rec.sample);
+			break;
+		}
+	}
+	flush(burst_band, burst);
+
+	double secs = duration<double>(steady_clock::now() - start).count();
+	std::cerr << "band replay: " << records << " records in " << secs << " s\n";
+}
+
+} /* namespace */
+
+std::unique_ptr<BandInputImpl> create_replay_input(const std::string& spec)
+{
+	std::string path = spec;
+	double speed = 1;
+
+	auto at = spec.rfind('@');
+	if (at != std::string::npos) {
+		path = spec.substr(0, at);
+		std::string s = spec.substr(at + 1);
+		if (s == "max") {
+			speed = 0;
+		} else {
+			char *end;
+			speed = strtod(s.c_str(), &end);
+			if (*end || !(speed > 0))
+				throw std::invalid_argument(spec + ": bad replay speed");
+		}
+	}
+
+	return std::make_unique<ReplayBandInput>(path, speed);
+}
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BandInputImpl.h"
+
+namespace {
+
+struct SynthParams
+{
+	unsigned bands = 16;
+	unsigned threads = 1;
+	double rate = 100;	// [samples/s] per band
+	unsigned burst = 1;	// samples delivered per band and wakeup
+	double gestures = 0.1;	// [1/s] per band
+	double noise = 0.02;	// [g]
+	unsigned seed = 1;
+};
+
+static constexpr double SHAKE_LEN = 0.6, SHAKE_FREQ = 8, SHAKE_FORCE = 1.2;
+static constexpr double TAP_FORCE = 2.5;
+static constexpr double ROT_LEN = 0.6, ROT_RATE = 0.8;
+static constexpr double SWING_LEN = 0.25, SWING_RATE = 1.5;
+static constexpr double MAX_LAG = 10;	// [periods] behind schedule before giving up on catching up
+
+struct SynthBandInfo final : public BandInfo
+{
+	// motion parameters
+	double amp, freq, phase;
+
+	// gesture being played, if any
+	int gesture;
+	double gesture_t;
+
+	SynthBandInfo(BandInputImpl& mgr_, BandEventQueue& evq_, std::minstd_rand& rng)
+		: BandInfo(mgr_, evq_), gesture(-1), gesture_t(0)
+	{
+		std::uniform_real_distribution<double> u(0, 1);
+		amp = 0.3 + 0.6 * u(rng);
+		freq = 0.1 + 0.4 * u(rng);
+		phase = 2 * M_PI * u(rng);
+	}
+
+	virtual void vibe(uint64_t) override {}
+
+	SensorData sample(double t, std::minstd_rand& rng, std::normal_distribution<double>& noise, double p_gesture);
+};
+
+// Pitch follows a clipped sine, so the band rests at the extremes and the
+// pitch detector fires; gestures are overlaid on top of the base motion.
+SensorData SynthBandInfo::sample(double t, std::minstd_rand& rng, std::normal_distribution<double>& noise, double p_gesture)
+{
+	double s = 1.5 * std::sin(2 * M_PI * freq * t + phase);
+	double ds = 1.5 * 2 * M_PI * freq * std::cos(2 * M_PI * freq * t + phase);
+	if (std::abs(s) >= 1) {
+		s = std::copysign(1.0, s);
+		ds = 0;
+	}
+	double th = amp * s * M_PI / 2;
+	double gy = amp * ds / 4;	// [360deg/s]
+
+	double ax = std::sin(th) + noise(rng), ay = noise(rng), az = std::cos(th) + noise(rng);
+	double gx = 0, gz = 0;
+
+	if (gesture < 0 && std::uniform_real_distribution<double>(0, 1)(rng) < p_gesture) {
+		gesture = std::uniform_int_distribution<int>(BandInput::GestureValue::SHAKE, BandInput::GestureValue::SWING)(rng);
+		gesture_t = t;
+	}
+
+	double dt = t - gesture_t;
+	switch (gesture) {
+	case BandInput::GestureValue::SHAKE:
+		ax += std::sin(2 * M_PI * SHAKE_FREQ * dt) >= 0 ? SHAKE_FORCE : -SHAKE_FORCE;
+		if (dt >= SHAKE_LEN)
+			gesture = -1;
+		break;
+	case BandInput::GestureValue::TAP:
+		az += TAP_FORCE;
+		gesture = -1;
+		break;
+	case BandInput::GestureValue::ROTATION:
+		gx = ROT_RATE;
+		if (dt >= ROT_LEN)
+			gesture = -1;
+		break;
+	case BandInput::GestureValue::SWING:
+		gz = SWING_RATE * std::sin(M_PI * dt / SWING_LEN);
+		if (dt >= SWING_LEN)
+			gesture = -1;
+		break;
+	}
+
+	SensorData d;
+	d.timestamp = (uint64_t)(t * 1000000);
+	d.v.ax = std::lround(ax * MAG_1G);
+	d.v.ay = std::lround(ay * MAG_1G);
+	d.v.az = std::lround(az * MAG_1G);
+	d.v.gx = std::lround(gx * ROT_360);
+	d.v.gy = std::lround(gy * ROT_360);
+	d.v.gz = std::lround(gz * ROT_360);
+	return d;
+}
+
+// N virtual bands spread over producer threads, each with its own event queue.
+class SynthBandInput final : public BandInputImpl
+{
+	SynthParams par;
+
+	std::mutex wait_lock;
+	std::condition_variable wake;
+	bool stopping;
+	std::vector<std::thread> threads;
+
+	void run(unsigned index, BandEventQueue& q);
+public:
+	explicit SynthBandInput(const SynthParams& p);
+	virtual ~SynthBandInput();
+};
+
+SynthBandInput::SynthBandInput(const SynthParams& p)
+	: par(p), stopping(false)
+{
+	std::vector<BandEventQueue *> qs{queues.front().get()};
+	while (qs.size() < par.threads)
+		qs.push_back(&add_queue());
+
+	for (unsigned i = 0; i < par.threads; ++i)
+		threads.emplace_back(&SynthBandInput::run, this, i, std::ref(*qs[i]));
+}
+
+SynthBandInput::~SynthBandInput()
+{
+	{
+		std::unique_lock<std::mutex> lock(wait_lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& t : threads)
+		t.join();
+}
+
+void SynthBandInput::run(unsigned index, BandEventQueue& q)
+{
+	using namespace std::chrono;
+
+	std::minstd_rand rng(par.seed * 7919 + index);
+	std::normal_distribution<double> noise(0, par.noise);
+
+	std::vector<SynthBandInfo *> mine;
+	for (unsigned i = index; i < par.bands; i += par.threads) {
+		auto band = static_cast<SynthBandInfo *>(add_band(std::make_unique<SynthBandInfo>(*this, q, rng)));
+		if (band)
+			mine.push_back(band);
+	}
+
+	double t0 = host_time_us() / 1e6;
+	for (auto band : mine)
+		band->initialized("synthetic #" + std::to_string(band->id), (uint64_t)(t0 * 1000000), DevIdData{0, 0xFFFF, 0x0001, 1});
+
+	auto period = duration_cast<steady_clock::duration>(duration<double>(par.burst / par.rate));
+	auto next = steady_clock::now();
+	double p_gesture = par.gestures / par.rate;
+	uint64_t tick = 0;
+	std::vector<SensorData> burst(par.burst);
+
+	for (;;) {
+		for (auto band : mine) {
+			for (unsigned k = 0; k < par.burst; ++k)
+				burst[k] = band->sample(t0 + (tick + k) / par.rate, rng, noise, p_gesture);
+			band->process_samples(burst.data(), burst.size());
+		}
+		tick += par.burst;
+
+		next += period;
+		auto now = steady_clock::now();
+		if (now - next > MAX_LAG * period)
+			next = now;
+
+		std::unique_lock<std::mutex> lock(wait_lock);
+		if (wake.wait_until(lock, next, [this] { return stopping; }))
+			break;
+	}
+}
+
+SynthParams parse_params(const std::string& spec)
+{
+	SynthParams p;
+	std::istringstream in(spec);
+	std::string item;
+
+	while (std::getline(in, item, ',')) {
+		auto eq = item.find('=');
+		std::string key = item.substr(0, eq);
+		const char *val = eq == std::string::npos ? "" : item.c_str() + eq + 1;
+		char *end;
+		double v = strtod(val, &end);
+		if (!*val || *end || !(v >= 0))
+			throw std::invalid_argument(spec + ": bad value for " + key);
+
+		if (key == "bands")
+			p.bands = v;
+		else if (key == "threads")
+			p.threads = v;
+		else if (key == "rate")
+			p.rate = v;
+		else if (key == "burst")
+			p.burst = v;
+		else if (key == "gestures")
+			p.gestures = v;
+		else if (key == "noise")
+			p.noise = v;
+		else if (key == "seed")
+			p.seed = v;
+		else
+			throw std::invalid_argument(spec + ": unknown parameter " + key);
+	}
+
+	if (!(p.rate > 0))
+		throw std::invalid_argument(spec + ": rate must be positive");
+	p.threads = std::max(1u, std::min(p.threads, p.bands));
+	p.burst = std::max(1u, p.burst);
+	return p;
+}
+
+} /* namespace */
+
+std::unique_ptr<BandInputImpl> create_synth_input(const std::string& spec)
+{
+	auto p = parse_params(spec);
+	std::cerr << "band input: " << p.bands << " synthetic bands at " << p.rate << " Hz on " << p.threads << " threads\n";
+	return std::make_unique<SynthBandInput>(p);
+}
@@ -0,0 +1,197 @@
+#include "BandView.h"
+
+#include <algorithm>
+#include <cmath>
+
+USING_NS_CC;
+
+static constexpr float HIT_RADIUS = 24;
+
+BandView *BandView::create(const std::string& texture)
+{
+	auto tex = Director::getInstance()->getTextureCache()->addImage(texture);
+	if (!tex)
+		return nullptr;
+
+	auto p = new (std::nothrow) BandView();
+	if (p && p->initWithTexture(tex)) {
+		p->autorelease();
+		return p;
+	}
+	delete p;
+	return nullptr;
+}
+
+BandView::BandView()
+	: relayout(false), atlas(nullptr), blend(BlendFunc::ALPHA_PREMULTIPLIED), columns(1)
+{
+}
+
+BandView::~BandView()
+{
+	CC_SAFE_RELEASE(atlas);
+}
+
+bool BandView::initWithTexture(Texture2D *texture)
+{
+	if (!Node::init())
+		return false;
+
+	atlas = new (std::nothrow) TextureAtlas();
+	if (!atlas || !atlas->initWithTexture(texture, 64))
+		return false;
+
+	if (!texture->hasPremultipliedAlpha())
+		blend = BlendFunc::ALPHA_NON_PREMULTIPLIED;
+	setGLProgramState(GLProgramState::getOrCreateWithGLProgramName(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR, texture));
+
+	cell = texture->getContentSize();
+	return true;
+}
+
+void BandView::reindex(size_t from)
+{
+	for (size_t i = from; i < slots.size(); ++i)
+		index[slots[i].id] = i;
+
+	// positions moved, layout() rewrites every quad and clears the flags
+	dirty.clear();
+	relayout = true;
+}
+
+bool BandView::addBand(unsigned id)
+{
+	if (index.count(id))
+		return false;
+
+	auto p = std::lower_bound(slots.begin(), slots.end(), id, [] (const Slot& s, unsigned id) { return s.id < id; });
+	size_t i = p - slots.begin();
+	slots.insert(p, Slot{id, 45, 0, false});
+	reindex(i);
+	return true;
+}
+
+void BandView::removeBand(unsigned id)
+{
+	auto p = index.find(id);
+	if (p == index.end())
+		return;
+
+	size_t i = p->second;
+	index.erase(p);
+	slots.erase(slots.begin() + i);
+	reindex(i);
+}
+
+void BandView::setPitch(unsigned id, float value)
+{
+	auto p = index.find(id);
+	if (p == index.end())
+		return;
+
+	Slot& s = slots[p->second];
+	float rotation = 45 - 90 * value;
+	if (rotation == s.rotation)
+		return;
+	s.rotation = rotation;
+
+	if (!relayout && !s.dirty) {
+		s.dirty = true;
+		dirty.push_back(p->second);
+	}
+}
+
+unsigned BandView::bandAt(const Vec2& pt) const
+{
+	if (slots.empty())
+		return 0;
+
+	float x = (pt.x - origin.x) / cell.width, y = (pt.y - origin.y) / cell.height;
+	if (x < 0 || y < 0 || x >= columns)
+		return 0;
+
+	size_t i = (size_t)y * columns + (size_t)x;
+	if (i >= slots.size() || center(i).distanceSquared(pt) > HIT_RADIUS * HIT_RADIUS)
+		return 0;
+	return slots[i].id;
+}
+
+uintptr_t BandView::getBandData(unsigned id) const
+{
+	auto p = index.find(id);
+	return p != index.end() ? slots[p->second].data : 0;
+}
+
+void BandView::setBandData(unsigned id, uintptr_t data)
+{
+	auto p = index.find(id);
+	if (p != index.end())
+		slots[p->second].data = data;
+}
+
+Vec2 BandView::center(size_t i) const
+{
+	return Vec2(origin.x + (i % columns + 0.5f) * cell.width, origin.y + (i / columns + 0.5f) * cell.height);
+}
+
+void BandView::layout()
+{
+	auto director = Director::getInstance();
+	Size visible = director->getVisibleSize();
+	origin = director->getVisibleOrigin();
+	columns = std::max<size_t>(1, visible.width / cell.width);
+
+	if ((ssize_t)slots.size() > atlas->getCapacity())
+		atlas->resizeCapacity(slots.size() * 4 / 3 + 1);
+	atlas->removeAllQuads();
+	atlas->increaseTotalQuadsWith(slots.size());
+
+	for (size_t i = 0; i < slots.size(); ++i)
+		write_quad(i);
+	relayout = false;
+}
+
+void BandView::write_quad(size_t i)
+{
+	Slot& s = slots[i];
+	s.dirty = false;
+
+	Texture2D *tex = atlas->getTexture();
+	float u = tex->getMaxS(), v = tex->getMaxT();
+	float hw = cell.width / 2, hh = cell.height / 2;
+
+	float rad = CC_DEGREES_TO_RADIANS(s.rotation);
+	float c = std::cos(rad), sn = std::sin(rad);
+	Vec2 at = center(i);
+
+	auto corner = [&] (V3F_C4B_T2F& out, float x, float y, float tu, float tv) {
+		out.vertices = Vec3(at.x + x * c + y * sn, at.y - x * sn + y * c, 0);
+		out.colors = Color4B::WHITE;
+		out.texCoords = Tex2F(tu, tv);
+	};
+
+	V3F_C4B_T2F_Quad& q = atlas->getQuads()[i];
+	corner(q.bl, -hw, -hh, 0, v);
+	corner(q.br, hw, -hh, u, v);
+	corner(q.tl, -hw, hh, 0, 0);
+	corner(q.tr, hw, hh, u, 0);
+}
+
+void BandView::draw(Renderer *renderer, const Mat4& transform, uint32_t flags)
+{
+	if (relayout) {
+		layout();
+		atlas->setDirty(true);
+	} else if (!dirty.empty()) {
+		for (size_t i : dirty)
+			write_quad(i);
+		dirty.clear();
+		atlas->setDirty(true);
+	}
+
+	if (slots.empty())
+		return;
+
+	command.init(_globalZOrder, getGLProgram(), blend, atlas, transform, flags);
+	renderer->addCommand(&command);
+}
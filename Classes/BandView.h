@@ -0,0 +1,65 @@
+#ifndef BANDGAME_VIEW_H_
+#define BANDGAME_VIEW_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cocos2d.h"
+
+// Indicators of all bands, drawn as one batch of quads out of one texture.
+// Setters only store the latest state of a band in a flat array; changed
+// quads are rebuilt once per frame when the view is drawn, the whole grid
+// when bands come or go. There are no nodes per band.
+class BandView : public cocos2d::Node
+{
+public:
+	static BandView *create(const std::string& texture);
+
+	bool addBand(unsigned id);
+	void removeBand(unsigned id);
+	// -1 is down, 1 is up
+	void setPitch(unsigned id, float value);
+
+	// band whose indicator is at pt (node space), 0 if none
+	unsigned bandAt(const cocos2d::Vec2& pt) const;
+
+	// per band value for the application, 0 for new bands
+	uintptr_t getBandData(unsigned id) const;
+	void setBandData(unsigned id, uintptr_t data);
+
+	virtual void draw(cocos2d::Renderer *renderer, const cocos2d::Mat4& transform, uint32_t flags) override;
+protected:
+	BandView();
+	virtual ~BandView();
+
+	bool initWithTexture(cocos2d::Texture2D *texture);
+private:
+	struct Slot
+	{
+		unsigned id;
+		float rotation;	// [deg] clockwise
+		uintptr_t data;
+		bool dirty;
+	};
+
+	std::vector<Slot> slots;	// by band id, in grid order
+	std::unordered_map<unsigned, size_t> index;
+	std::vector<size_t> dirty;
+	bool relayout;
+
+	cocos2d::TextureAtlas *atlas;
+	cocos2d::BatchCommand command;
+	cocos2d::BlendFunc blend;
+	cocos2d::Vec2 origin;
+	cocos2d::Size cell;
+	size_t columns;
+
+	void reindex(size_t from);
+	void layout();
+	void write_quad(size_t i);
+	cocos2d::Vec2 center(size_t i) const;
+};
+
+#endif /* BANDGAME_VIEW_H_ */
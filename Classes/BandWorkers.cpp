@@ -0,0 +1,190 @@
+#include "BandWorkers.h"
+
+#include <iostream>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "BandInputImpl.h"
+
+static constexpr size_t JOBS_SIZE = 8192;
+static constexpr size_t JOBS_CTRL_RESERVE = 64;	// slots kept free for INIT/REMOVE
+
+BandWorkers::Shard::Shard(BandEventQueue& evq_, size_t capacity)
+	: evq(evq_), jobs(capacity), bands(0), sleeping(false), stopping(false)
+{
+}
+
+void BandWorkers::Shard::post(const Job& j, bool control) noexcept
+{
+	if (control) {
+		// a lost INIT or REMOVE would leave the band half there
+		while (!jobs.push(j))
+			std::this_thread::yield();
+	} else if (!jobs.push(j, JOBS_CTRL_RESERVE)) {
+		return;
+	}
+
+	// pairs with the fence in run(): either the worker sees the job, or we see it sleeping
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_relaxed)) {
+		std::unique_lock<std::mutex> guard(lock);
+		wake.notify_one();
+	}
+}
+
+void BandWorkers::Shard::initialized(BandInfo *band, const std::string& name, uint64_t ts, const DevIdData& devid) noexcept
+{
+	Job j;
+	j.kind = Job::INIT;
+	j.band = band;
+	j.init.name = new (std::nothrow) std::string(name);
+	j.init.ts = ts;
+	j.init.devid = devid;
+	post(j, true);
+}
+
+void BandWorkers::Shard::sample(BandInfo *band, const SensorData& data) noexcept
+{
+	Job j;
+	j.kind = Job::SAMPLE;
+	j.band = band;
+	j.sample = data;
+	post(j, false);
+}
+
+void BandWorkers::Shard::removed(BandInfo *band) noexcept
+{
+	Job j;
+	j.kind = Job::REMOVE;
+	j.band = band;
+	post(j, true);
+}
+
+BandWorkers::BandWorkers(BandInputImpl& mgr_, unsigned n, const std::vector<int>& cpus)
+	: mgr(mgr_)
+{
+	for (unsigned i = 0; i < n; ++i)
+		shards.push_back(std::make_unique<Shard>(mgr.add_queue(), JOBS_SIZE));
+
+	for (unsigned i = 0; i < n; ++i) {
+		Shard& s = *shards[i];
+		s.worker = std::thread(&BandWorkers::run, this, std::ref(s));
+
+		if (i < cpus.size() && cpus[i] >= 0) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpus[i], &set);
+			int err = pthread_setaffinity_np(s.worker.native_handle(), sizeof(set), &set);
+			if (err)
+				std::cerr << "band input: can't pin worker " << i << " to cpu " << cpus[i] << " (error " << err << ")\n";
+		}
+	}
+}
+
+BandWorkers::~BandWorkers()
+{
+	stop();
+}
+
+BandWorkers::Shard& BandWorkers::assign() noexcept
+{
+	Shard *best = shards.front().get();
+	for (auto& s : shards)
+		if (s->bands.load(std::memory_order_relaxed) < best->bands.load(std::memory_order_relaxed))
+			best = s.get();
+	best->bands.fetch_add(1, std::memory_order_relaxed);
+	return *best;
+}
+
+void BandWorkers::release(Shard& s) noexcept
+{
+	s.bands.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void BandWorkers::stop()
+{
+	for (auto& s : shards) {
+		{
+			std::unique_lock<std::mutex> guard(s->lock);
+			s->stopping = true;
+		}
+		s->wake.notify_one();
+	}
+
+	for (auto& s : shards) {
+		if (!s->worker.joinable())
+			continue;
+		s->worker.join();
+
+		// names of bands that never got initialized
+		for (size_t n = s->jobs.readable(); n; --n) {
+			Job *j = s->jobs.front();
+			if (j->kind == Job::INIT)
+				delete j->init.name;
+			s->jobs.pop();
+		}
+	}
+}
+
+void BandWorkers::run(Shard& s)
+{
+	SensorData burst[SensorBatch::MAX];
+	BandInfo *burst_band = nullptr;
+	size_t burst_n = 0;
+
+	auto flush = [&] {
+		if (burst_n)
+			burst_band->process_samples(burst, burst_n);
+		burst_n = 0;
+	};
+
+	for (;;) {
+		size_t avail = s.jobs.readable();
+		if (!avail) {
+			flush();
+
+			std::unique_lock<std::mutex> guard(s.lock);
+			s.sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			s.wake.wait(guard, [&s] { return s.stopping || s.jobs.readable(); });
+			s.sleeping.store(false, std::memory_order_relaxed);
+			if (s.stopping)
+				return;
+			continue;
+		}
+
+		for (; avail; --avail) {
+			Job j = *s.jobs.front();
+			s.jobs.pop();
+
+			if (j.kind == Job::SAMPLE && j.band == burst_band && burst_n < SensorBatch::MAX) {
+				burst[burst_n++] = j.sample;
+				continue;
+			}
+			flush();
+
+			switch (j.kind) {
+			case Job::INIT:
+				if (j.init.name)
+					j.band->initialized(*j.init.name, j.init.ts, j.init.devid);
+				delete j.init.name;
+				break;
+			case Job::SAMPLE:
+				burst_band = j.band;
+				burst[burst_n++] = j.sample;
+				break;
+			case Job::REMOVE:
+				j.band->removed();
+				s.bands.fetch_sub(1, std::memory_order_relaxed);
+				if (burst_band == j.band)
+					burst_band = nullptr;
+				mgr.remove_band(j.band);
+				break;
+			}
+		}
+
+		// the burst ends with what has been queued so far
+		flush();
+	}
+}
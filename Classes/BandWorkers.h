@@ -0,0 +1,94 @@
+#ifndef BANDGAME_WORKERS_H_
+#define BANDGAME_WORKERS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "band.h"
+#include "SpscQueue.h"
+
+struct BandEventQueue;
+struct BandInfo;
+struct BandInputImpl;
+
+// Runs the processing pipeline of device bands on worker threads. The I/O
+// thread only hands the callbacks of a band to the shard it was assigned
+// to; the shard's worker processes them in order, consecutive samples of a
+// band as one burst, and is the only producer of the shard's event queue.
+class BandWorkers
+{
+public:
+	struct Job
+	{
+		enum Kind { INIT, SAMPLE, REMOVE };
+
+		Kind kind;
+		BandInfo *band;
+		union {
+			SensorData sample;
+			struct {
+				std::string *name;	// owned by the job
+				uint64_t ts;
+				DevIdData devid;
+			} init;
+		};
+
+		Job() {}
+	};
+
+	class Shard
+	{
+		friend class BandWorkers;
+
+		BandEventQueue& evq;
+		SpscQueue<Job> jobs;
+		std::atomic<unsigned> bands;
+
+		std::mutex lock;
+		std::condition_variable wake;
+		std::atomic<bool> sleeping;
+		bool stopping;
+		std::thread worker;
+
+		void post(const Job& j, bool control) noexcept;
+	public:
+		Shard(BandEventQueue& evq_, size_t capacity);
+
+		BandEventQueue& queue() const { return evq; }
+
+		// I/O thread side
+		void initialized(BandInfo *band, const std::string& name, uint64_t ts, const DevIdData& devid) noexcept;
+		void sample(BandInfo *band, const SensorData& data) noexcept;
+		// the worker drops the band's processing state once the jobs before have
+		// been processed; the device must be gone already
+		void removed(BandInfo *band) noexcept;
+
+		uint64_t droppedCount() const noexcept { return jobs.overflowCount(); }
+	};
+
+	// one event queue per shard is added to mgr; cpus[i], if any, pins worker i
+	BandWorkers(BandInputImpl& mgr_, unsigned n, const std::vector<int>& cpus);
+	~BandWorkers();
+
+	BandWorkers(const BandWorkers&) = delete;
+	BandWorkers& operator=(const BandWorkers&) = delete;
+
+	// shard with the fewest bands
+	Shard& assign() noexcept;
+	// undoes assign() for a band that couldn't be added
+	void release(Shard& s) noexcept;
+
+	void stop();
+private:
+	BandInputImpl& mgr;
+	std::vector<std::unique_ptr<Shard>> shards;
+
+	void run(Shard& s);
+};
+
+#endif /* BANDGAME_WORKERS_H_ */
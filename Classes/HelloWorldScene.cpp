@@ -23,6 +23,7 @@
  ****************************************************************************/
 
 #include "HelloWorldScene.h"
+#include "BandView.h"
 #include "SimpleAudioEngine.h"
 
 USING_NS_CC;
@@ -115,73 +116,30 @@ bool HelloWorld::init()
         // add the sprite as a child to this layer
         this->addChild(sprite, 0);
     }
-    return true;
-}
 
-static void reorder_bands(std::map<unsigned, Sprite *>& arrows, Point origin, Size visibleSize)
-{
-	if (arrows.empty())
-		return;
-
-	auto& box = arrows.begin()->second->getTextureRect();
-	size_t nw = visibleSize.width / box.size.width;
-	origin.x += box.size.width / 2;
-	origin.y += box.size.height / 2;
-
-	size_t i = 0, j = 0;
-	for (auto& a : arrows) {
-		Sprite& arrow = *a.second;
-		arrow.setPosition(origin.x + i * box.size.width, origin.y + j * box.size.height);
-		if (++i >= nw)
-			++j, i = 0;
-	}
+    bands = BandView::create("green-arrow-ur.png");
+    if (!bands)
+        problemLoading("'green-arrow-ur.png'");
+    else
+        this->addChild(bands, 1);
+    return true;
 }
 
-Sprite *HelloWorld::addBand(unsigned id)
+bool HelloWorld::addBand(unsigned id)
 {
-	auto& arrow = arrows[id];
-	if (arrow)
-		return nullptr;
-
-	// add arrow
-	arrow = Sprite::create("green-arrow-ur.png");
-	if (!arrow) {
-		arrows.erase(id);
-		problemLoading("'green-arrow-ur.png'");
-		return nullptr;
-	}
-
-	Size visibleSize = Director::getInstance()->getVisibleSize();
-	Point origin = Director::getInstance()->getVisibleOrigin();
-
-	this->addChild(arrow, 1);
-	reorder_bands(arrows, origin, visibleSize);
-
-	return arrow;
+	return bands && bands->addBand(id);
 }
 
 void HelloWorld::removeBand(unsigned id)
 {
-	auto& arrow = arrows[id];
-	arrows.erase(id);
-	if (!arrow)
-		return;
-
-	Size visibleSize = Director::getInstance()->getVisibleSize();
-	Point origin = Director::getInstance()->getVisibleOrigin();
-
-	this->removeChild(arrow, true);
-	reorder_bands(arrows, origin, visibleSize);
+	if (bands)
+		bands->removeBand(id);
 }
 
 void HelloWorld::updateBandPitch(unsigned id, float value)
 {
-	auto p = arrows.find(id);
-	if (p == arrows.end())
-		return;
-	Sprite *arrow = p->second;
-
-	arrow->setRotation(45 - 90 * value);
+	if (bands)
+		bands->setPitch(id, value);
 }
 
 void HelloWorld::menuCloseCallback(Ref* pSender)
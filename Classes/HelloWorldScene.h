@@ -26,11 +26,14 @@
 #define __HELLOWORLD_SCENE_H__
 
 #include "cocos2d.h"
+#include "SequenceGame.h"
 #include <vector>
 
-class HelloWorld : public cocos2d::Scene
+class BandView;
+
+class HelloWorld : public cocos2d::Scene, public SequenceDisplay
 {
-    std::map<unsigned, cocos2d::Sprite *> arrows;
+    BandView *bands = nullptr;
 public:
     static cocos2d::Scene* createScene();
 
@@ -42,9 +45,11 @@ public:
     // implement the "static create()" method manually
     CREATE_FUNC(HelloWorld);
 
-    cocos2d::Sprite *addBand(unsigned id);
-    void removeBand(unsigned id);
-    void updateBandPitch(unsigned id, float value);
+    BandView *getBandView() const { return bands; }
+
+    virtual bool addBand(unsigned id) override;
+    virtual void removeBand(unsigned id) override;
+    virtual void updateBandPitch(unsigned id, float value) override;
 };
 
 #endif // __HELLOWORLD_SCENE_H__
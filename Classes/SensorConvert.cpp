@@ -0,0 +1,204 @@
+#include "SensorConvert.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#else
+#define HAVE_X86_SIMD 0
+#endif
+
+#include "band.h"
+
+static constexpr float INV_MAG_1G = 1 / MAG_1G;
+static constexpr float INV_ROT_360 = 1 / ROT_360;
+static constexpr float HALF_PI = M_PI / 2;
+static constexpr float TWO_BY_PI = 2 / M_PI;
+
+// minimax odd polynomial for atan(t), t in [0, 1]
+static constexpr float ATAN_C[] = {
+	0.99997726f, -0.33262347f, 0.19354346f, -0.11643287f, 0.05265332f, -0.01172120f,
+};
+
+static inline float atan_poly(float t) noexcept
+{
+	float t2 = t * t;
+	float p = ATAN_C[5];
+	for (int i = 4; i >= 0; --i)
+		p = p * t2 + ATAN_C[i];
+	return p * t;
+}
+
+// atan2(y, x) * 2 / pi for x >= 0
+static inline float pitch_approx(float y, float x) noexcept
+{
+	float ay = std::abs(y);
+	float mx = std::max(ay, x), mn = std::min(ay, x);
+	float a = mx > 0 ? atan_poly(mn / mx) : 0;
+	if (ay > x)
+		a = HALF_PI - a;
+	return std::copysign(a * TWO_BY_PI, y);
+}
+
+static void convert_scalar(SensorBatch& b, size_t from) noexcept
+{
+	float *ax = b.ch[SampleHistory::AX], *ay = b.ch[SampleHistory::AY], *az = b.ch[SampleHistory::AZ];
+	for (size_t c = SampleHistory::AX; c <= SampleHistory::AZ; ++c)
+		for (size_t i = from; i < b.n; ++i)
+			b.ch[c][i] *= INV_MAG_1G;
+	for (size_t c = SampleHistory::GX; c <= SampleHistory::GZ; ++c)
+		for (size_t i = from; i < b.n; ++i)
+			b.ch[c][i] *= INV_ROT_360;
+
+	for (size_t i = from; i < b.n; ++i) {
+		b.ch[SampleHistory::MAG][i] = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+		b.ch[SampleHistory::PITCH][i] = pitch_approx(ax[i], std::sqrt(ay[i] * ay[i] + az[i] * az[i]));
+	}
+}
+
+#if HAVE_X86_SIMD
+
+static inline __m128 sqrt_nr_ps(__m128 s) noexcept
+{
+	__m128 y = _mm_rsqrt_ps(s);
+	y = _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), s), _mm_mul_ps(y, y))));
+	return _mm_and_ps(_mm_mul_ps(s, y), _mm_cmpgt_ps(s, _mm_setzero_ps()));
+}
+
+static inline __m128 pitch_ps(__m128 y, __m128 x) noexcept
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 ay = _mm_andnot_ps(sign, y);
+	__m128 mx = _mm_max_ps(ay, x), mn = _mm_min_ps(ay, x);
+	__m128 t = _mm_and_ps(_mm_div_ps(mn, mx), _mm_cmpgt_ps(mx, _mm_setzero_ps()));
+	__m128 t2 = _mm_mul_ps(t, t);
+	__m128 p = _mm_set1_ps(ATAN_C[5]);
+	for (int i = 4; i >= 0; --i)
+		p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(ATAN_C[i]));
+	p = _mm_mul_ps(p, t);
+
+	__m128 swap = _mm_cmpgt_ps(ay, x);
+	p = _mm_or_ps(_mm_and_ps(swap, _mm_sub_ps(_mm_set1_ps(HALF_PI), p)), _mm_andnot_ps(swap, p));
+	p = _mm_mul_ps(p, _mm_set1_ps(TWO_BY_PI));
+	return _mm_or_ps(p, _mm_and_ps(sign, y));
+}
+
+static size_t convert_sse(SensorBatch& b) noexcept
+{
+	const __m128 kg = _mm_set1_ps(INV_MAG_1G), kr = _mm_set1_ps(INV_ROT_360);
+	size_t i = 0;
+	for (; i + 4 <= b.n; i += 4) {
+		__m128 ax = _mm_mul_ps(_mm_load_ps(&b.ch[SampleHistory::AX][i]), kg);
+		__m128 ay = _mm_mul_ps(_mm_load_ps(&b.ch[SampleHistory::AY][i]), kg);
+		__m128 az = _mm_mul_ps(_mm_load_ps(&b.ch[SampleHistory::AZ][i]), kg);
+		_mm_store_ps(&b.ch[SampleHistory::AX][i], ax);
+		_mm_store_ps(&b.ch[SampleHistory::AY][i], ay);
+		_mm_store_ps(&b.ch[SampleHistory::AZ][i], az);
+		for (size_t c = SampleHistory::GX; c <= SampleHistory::GZ; ++c)
+			_mm_store_ps(&b.ch[c][i], _mm_mul_ps(_mm_load_ps(&b.ch[c][i]), kr));
+
+		__m128 yz = _mm_add_ps(_mm_mul_ps(ay, ay), _mm_mul_ps(az, az));
+		__m128 mag = sqrt_nr_ps(_mm_add_ps(yz, _mm_mul_ps(ax, ax)));
+		_mm_store_ps(&b.ch[SampleHistory::MAG][i], mag);
+		_mm_store_ps(&b.ch[SampleHistory::PITCH][i], pitch_ps(ax, sqrt_nr_ps(yz)));
+	}
+	return i;
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 sqrt_nr_ps(__m256 s) noexcept
+{
+	__m256 y = _mm256_rsqrt_ps(s);
+	y = _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), s), _mm256_mul_ps(y, y), _mm256_set1_ps(1.5f)));
+	return _mm256_and_ps(_mm256_mul_ps(s, y), _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 pitch_ps(__m256 y, __m256 x) noexcept
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 ay = _mm256_andnot_ps(sign, y);
+	__m256 mx = _mm256_max_ps(ay, x), mn = _mm256_min_ps(ay, x);
+	__m256 t = _mm256_and_ps(_mm256_div_ps(mn, mx), _mm256_cmp_ps(mx, _mm256_setzero_ps(), _CMP_GT_OQ));
+	__m256 t2 = _mm256_mul_ps(t, t);
+	__m256 p = _mm256_set1_ps(ATAN_C[5]);
+	for (int i = 4; i >= 0; --i)
+		p = _mm256_fmadd_ps(p, t2, _mm256_set1_ps(ATAN_C[i]));
+	p = _mm256_mul_ps(p, t);
+
+	__m256 swap = _mm256_cmp_ps(ay, x, _CMP_GT_OQ);
+	p = _mm256_blendv_ps(p, _mm256_sub_ps(_mm256_set1_ps(HALF_PI), p), swap);
+	p = _mm256_mul_ps(p, _mm256_set1_ps(TWO_BY_PI));
+	return _mm256_or_ps(p, _mm256_and_ps(sign, y));
+}
+
+__attribute__((target("avx2,fma")))
+static size_t convert_avx2(SensorBatch& b) noexcept
+{
+	const __m256 kg = _mm256_set1_ps(INV_MAG_1G), kr = _mm256_set1_ps(INV_ROT_360);
+	size_t i = 0;
+	for (; i + 8 <= b.n; i += 8) {
+		__m256 ax = _mm256_mul_ps(_mm256_load_ps(&b.ch[SampleHistory::AX][i]), kg);
+		__m256 ay = _mm256_mul_ps(_mm256_load_ps(&b.ch[SampleHistory::AY][i]), kg);
+		__m256 az = _mm256_mul_ps(_mm256_load_ps(&b.ch[SampleHistory::AZ][i]), kg);
+		_mm256_store_ps(&b.ch[SampleHistory::AX][i], ax);
+		_mm256_store_ps(&b.ch[SampleHistory::AY][i], ay);
+		_mm256_store_ps(&b.ch[SampleHistory::AZ][i], az);
+		for (size_t c = SampleHistory::GX; c <= SampleHistory::GZ; ++c)
+			_mm256_store_ps(&b.ch[c][i], _mm256_mul_ps(_mm256_load_ps(&b.ch[c][i]), kr));
+
+		__m256 yz = _mm256_fmadd_ps(ay, ay, _mm256_mul_ps(az, az));
+		__m256 mag = sqrt_nr_ps(_mm256_fmadd_ps(ax, ax, yz));
+		_mm256_store_ps(&b.ch[SampleHistory::MAG][i], mag);
+		_mm256_store_ps(&b.ch[SampleHistory::PITCH][i], pitch_ps(ax, sqrt_nr_ps(yz)));
+	}
+	return i;
+}
+
+static size_t convert_simd(SensorBatch& b) noexcept
+{
+	static size_t (*const impl)(SensorBatch&) noexcept = [] {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? convert_avx2 : convert_sse;
+	}();
+	return impl(b);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+void convert_samples(const SensorData *in, size_t n, SensorBatch& b) noexcept
+{
+	b.n = std::min(n, SensorBatch::MAX);
+
+	// AoS -> SoA; the SIMD passes below work in place
+	for (size_t i = 0; i < b.n; ++i) {
+		const SensorData& d = in[i];
+		b.ts[i] = d.timestamp;
+		b.ch[SampleHistory::AX][i] = d.v.ax;
+		b.ch[SampleHistory::AY][i] = d.v.ay;
+		b.ch[SampleHistory::AZ][i] = d.v.az;
+		b.ch[SampleHistory::GX][i] = d.v.gx;
+		b.ch[SampleHistory::GY][i] = d.v.gy;
+		b.ch[SampleHistory::GZ][i] = d.v.gz;
+	}
+
+	size_t done = 0;
+#if HAVE_X86_SIMD
+	done = convert_simd(b);
+#endif
+	convert_scalar(b, done);
+}
+
+void convert_sample_exact(const SensorData& in, float (&out)[SampleHistory::CHANNELS]) noexcept
+{
+	out[SampleHistory::AX] = in.v.ax / MAG_1G;
+	out[SampleHistory::AY] = in.v.ay / MAG_1G;
+	out[SampleHistory::AZ] = in.v.az / MAG_1G;
+	out[SampleHistory::GX] = in.v.gx / ROT_360;
+	out[SampleHistory::GY] = in.v.gy / ROT_360;
+	out[SampleHistory::GZ] = in.v.gz / ROT_360;
+	out[SampleHistory::MAG] = std::hypot(in.v.ax, in.v.ay, in.v.az) / MAG_1G;
+	out[SampleHistory::PITCH] = std::atan2(in.v.ax, std::hypot(in.v.ay, in.v.az)) * 2 / M_PI;
+}
@@ -0,0 +1,33 @@
+#ifndef BANDGAME_SENSOR_CONVERT_H_
+#define BANDGAME_SENSOR_CONVERT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "BandHistory.h"
+
+struct SensorData;
+
+static constexpr double MAG_1G = 1000000.0 / 488;	// raw units per 1g
+static constexpr double ROT_360 = 360000.0 / 70;	// raw units per 360deg/s
+
+// A burst of samples converted to physical units, one array per channel.
+struct SensorBatch
+{
+	static constexpr size_t MAX = 64;
+
+	size_t n;
+	int64_t ts[MAX];	// [us] device time
+	alignas(32) float ch[SampleHistory::CHANNELS][MAX];
+};
+
+// Converts up to SensorBatch::MAX samples. Uses AVX2 or SSE when the CPU has
+// them, scalar code otherwise. SIMD paths take the magnitude from rsqrt with
+// one Newton step; all paths compute pitch with the same polynomial atan2
+// (|error| < 1e-5 of the [-1, 1] range).
+void convert_samples(const SensorData *in, size_t n, SensorBatch& out) noexcept;
+
+// reference per-sample conversion, as done before batching
+void convert_sample_exact(const SensorData& in, float (&out)[SampleHistory::CHANNELS]) noexcept;
+
+#endif /* BANDGAME_SENSOR_CONVERT_H_ */
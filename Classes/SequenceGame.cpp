@@ -1,164 +1,289 @@
 #include "SequenceGame.h"
 #include "BandInput.h"
+#include "BandLatency.h"
+#include "WatermarkMerger.h"
 #include "cocos2d.h"
 
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <cstdio>
 #include <iostream>
-#include <map>
 #include <random>
 #include <utility>
 #include <vector>
 
-#include <time.h>
-
 USING_NS_CC;
 
+// one round, played by the bands of a session
 struct GameData
 {
 	SequenceGame& game;
+	const unsigned index;
+	std::vector<uint32_t> members;	// slots
+	std::vector<uint32_t> retired;	// slots of bands removed during the round
 	std::random_device rd;
-	std::vector<std::pair<unsigned, BandData::Dir>> sequence;
-	std::map<float, std::vector<std::pair<unsigned, BandData::Dir>>> backlog;
-	std::map<unsigned, float> band_ts;
+	std::vector<std::pair<uint32_t, BandData::Dir>> sequence;
+	WatermarkMerger<BandData::Dir> backlog;	// keyed by slot
+	std::vector<std::pair<uint32_t, bool>> signal;
 	size_t current, missed;
-	float start_ts;
-	bool listening;
+	int64_t start_ts, listen_ts;	// BandInput::now() time base
+	bool listening, dirty;
 
-	GameData(SequenceGame& game_) : game(game_), current(0), missed(0), listening(false) {}
+	GameData(SequenceGame& game_, unsigned index_)
+		: game(game_), index(index_), current(0), missed(0), start_ts(0), listen_ts(0), listening(false), dirty(false) {}
 
 	void clear();
-	void generate_sequence(const std::vector<unsigned>& ids, size_t n);
-	void push_direction_change(unsigned id, float ts, BandData::Dir dir);
-	void advance_time(unsigned id, float ts);
-	bool test_sequence(unsigned id, BandData::Dir dir);
+	void drop(uint32_t slot);
+	void generate_sequence(size_t n);
+	void evaluate();
+	bool test_sequence(uint32_t slot, BandData::Dir dir);
 	bool in_progress() const { return current != sequence.size(); }
+	unsigned band_id(uint32_t slot) const { return game.slots[slot].id; }
 };
 
-static BandData sentinel;
+static constexpr int64_t STEP_US = 1000000;	// between two cues of a sequence
+static constexpr int64_t SETTLE_MARGIN_US = 5000;	// from draining the band queues to flush()
 
-static float float_ts() noexcept
-{
-	struct timespec tv;
-	if (clock_gettime(CLOCK_MONOTONIC, &tv))
-		return 0;	// FIXME
-	return (float)tv.tv_sec + (float)tv.tv_nsec / 1000000000;
-}
+static const std::string dir_name[] = { "DOWN", "LOW", "LEVEL", "HIGH", "UP" };
 
-SequenceGame::SequenceGame()
-	: data(std::make_unique<GameData>(*this)), start_ts(0)
+SequenceGame::SequenceGame(size_t session_size_)
+	: session_size(session_size_)
 {
 }
 
 SequenceGame::~SequenceGame() = default;
 
-void SequenceGame::addBand(unsigned id, Node *arrow)
+size_t SequenceGame::envSessionSize()
 {
-	auto& bd = bands.emplace(std::piecewise_construct, std::make_tuple(id), std::make_tuple(std::ref(*data), id)).first->second;
-	bd.arrow = arrow;
+	const char *ssize = getenv("BANDGAME_SESSION_SIZE");
+	return ssize ? strtoul(ssize, nullptr, 0) : 0;
 }
 
-void SequenceGame::removeBand(unsigned id)
+uint32_t SequenceGame::slot(unsigned id) const noexcept
 {
-	bands.erase(id);
+	auto p = slot_index.find(id);
+	return p != slot_index.end() ? p->second : NO_SLOT;
 }
 
-BandData& SequenceGame::band(unsigned id) noexcept
+unsigned SequenceGame::assign_session()
 {
-	auto p = bands.find(id);
-	return p != bands.end() ? p->second : sentinel;
-}
+	if (!session_size) {
+		if (sessions.empty())
+			sessions.emplace_back(std::make_unique<GameData>(*this, 0));
+		return 0;
+	}
 
-void SequenceGame::updateBandPitch(unsigned id, float ts, float value)
-{
-	band(id).updatePitch(ts, value);
+	// fill up idle sessions first, then reuse empty ones
+	for (auto& s : sessions)
+		if (!s->in_progress() && !s->members.empty() && s->members.size() < session_size)
+			return s->index;
+	for (auto& s : sessions)
+		if (!s->in_progress() && s->members.empty())
+			return s->index;
+
+	sessions.emplace_back(std::make_unique<GameData>(*this, sessions.size()));
+	return sessions.back()->index;
 }
 
-void SequenceGame::updateBandTime(unsigned id, float ts)
+void SequenceGame::addBand(unsigned id)
 {
-	band(id).updateTime(ts);
+	uint32_t s;
+	if (free_slots.empty()) {
+		s = slots.size();
+		slots.emplace_back();
+	} else {
+		s = free_slots.back();
+		free_slots.pop_back();
+	}
+
+	unsigned session = assign_session();
+	slots[s] = BandData{id, session, BandData::LEVEL};
+	slot_index[id] = s;
+	sessions[session]->members.push_back(s);
+
+	if (sessions.size() > 1)
+		std::cerr << "band #" << id << " joins session " << session << '\n';
 }
 
-void SequenceGame::start()
+void SequenceGame::removeBand(unsigned id)
 {
-	if (data->in_progress())
+	uint32_t s = slot(id);
+	if (s == NO_SLOT)
 		return;
+	slot_index.erase(id);
 
-	data->clear();
-
-	std::vector<unsigned> ids(bands.size());
-	std::transform(bands.begin(), bands.end(), ids.begin(), [] (const auto& p) { return p.second.id; });
-	data->generate_sequence(ids, std::max<size_t>(3, ids.size() * 2));
+	auto& sd = *sessions[slots[s].session];
+	auto p = std::find(sd.members.begin(), sd.members.end(), s);
+	if (p != sd.members.end()) {
+		*p = sd.members.back();
+		sd.members.pop_back();
+	}
+	sd.backlog.remove(s);
+	slots[s].id = 0;
 
-	std::vector<Sequence *> vibes;
-	vibes.reserve(bands.size());
+	// nobody left to play the round
+	if (sd.members.empty() && sd.in_progress()) {
+		BandInput::VibeAction::cancelTimeline(sd.index);
+		sd.clear();
+	} else {
+		// the others may have been waiting for the band
+		sd.drop(s);
+		if (sd.listening)
+			mark_dirty(sd);
+	}
 
-	for (auto& bdp : bands) {
-		unsigned band_id = bdp.second.id;
-		size_t n = std::count_if(data->sequence.begin(), data->sequence.end(), [band_id] (const auto& p) { return p.first == band_id; });
-		if (!n) {
-			vibes.emplace_back(nullptr);
-			continue;
-		}
+	// the round's sequence may still refer to the slot
+	if (sd.in_progress())
+		sd.retired.push_back(s);
+	else
+		free_slots.push_back(s);
+}
 
-		Vector<FiniteTimeAction *> va(2 * n + 1);
-		size_t last = ~(size_t)0;
-		for (size_t i = 0; i < data->sequence.size(); ++i) {
-			if (data->sequence[i].first != band_id)
-				continue;
+void SequenceGame::processSpan(const BandInput::EventSpan& span)
+{
+	uint32_t s = slot(span.band_id);
+	if (s == NO_SLOT)
+		return;
 
-			int dir = (int)data->sequence[i].second;
-			uint64_t effect = BandInput::VibeAction::dd5_effect(dir);
-			size_t delay = i - last;
+	for (auto& rec : span) {
+		switch (rec.data.type) {
+		case BandInput::EventData::PITCH:
+			update_pitch(s, rec.data.detection_ts, rec.pitch.pitch);
+			break;
+		case BandInput::EventData::RAW:
+		case BandInput::EventData::TIME:
+			update_time(s, rec.data.detection_ts);
+			break;
+		default:
+			break;
+		}
+	}
+}
 
-			va.pushBack(DelayTime::create(delay));
-			va.pushBack(BandInput::VibeAction::create(band_id, effect));
+void SequenceGame::processBatch(const BandInput::Batch& batch, SequenceDisplay *display)
+{
+	for (auto& span : batch) {
+		unsigned band_id = span.band_id;
+		const BandInput::GesturePitchValue *last_pitch = nullptr;
+		bool removed = false;
+
+		for (auto& rec : span) {
+			switch (rec.data.type) {
+			case BandInput::EventData::ADDED:
+				if (!display || display->addBand(band_id))
+					addBand(band_id);
+				break;
+			case BandInput::EventData::REMOVED:
+				removed = true;
+				last_pitch = nullptr;
+				break;
+			case BandInput::EventData::PITCH:
+				last_pitch = &rec.pitch;
+				break;
+			default:
+				break;
+			}
+			BandLatency::consumed(rec.data);
+		}
 
-			last = i;
+		processSpan(span);
+		if (removed) {
+			if (display)
+				display->removeBand(band_id);
+			removeBand(band_id);
 		}
 
-		va.pushBack(DelayTime::create(data->sequence.size() - last));
-		vibes.emplace_back(Sequence::create(va));
+		// only the newest pitch is visible on screen
+		if (display && last_pitch)
+			display->updateBandPitch(band_id, last_pitch->pitch);
 	}
+	flush();
+}
 
-	size_t i = 0;
-	for (auto& bdp : bands) {
-		auto act = vibes[i++];
-		if (act)
-			bdp.second.arrow->runAction(act);
-	}
+void SequenceGame::flush()
+{
+	settle();
 
-	start_ts = float_ts() + data->sequence.size() + 1;
+	for (unsigned i : dirty) {
+		sessions[i]->dirty = false;
+		sessions[i]->evaluate();
+	}
+	dirty.clear();
 }
 
-void SequenceGame::update()
+// A band says nothing about its time between heartbeats. Once its clock is
+// synced, nothing older than now - jitter can still arrive from it, so the
+// round doesn't have to wait for the band's next record.
+void SequenceGame::settle()
 {
-	float ts = float_ts();
+	auto& in = BandInput::getInstance();
+	int64_t horizon = BandInput::now() - SETTLE_MARGIN_US;
 
-	if (start_ts != 0 && ts >= start_ts) {
-		data->listening = true;
-		start_ts = 0;
-		std::cerr << "\nMOVE!\n\n";
+	for (auto& s : sessions) {
+		if (!s->listening)
+			continue;
+		for (uint32_t slot : s->members) {
+			uint32_t jitter;
+			if (in.getClockJitter(slots[slot].id, jitter))
+				s->backlog.advance(slot, horizon - jitter);
+		}
+		if (!s->backlog.empty())
+			mark_dirty(*s);
 	}
 }
 
-BandData::BandData()
-	: game(nullptr), id(0), arrow(nullptr)
+void SequenceGame::mark_dirty(GameData& s)
 {
+	if (s.dirty)
+		return;
+	s.dirty = true;
+	dirty.push_back(s.index);
 }
 
-BandData::BandData(GameData& game_, unsigned id_)
-	: game(std::addressof(game_)), id(id_), arrow(nullptr)
+void SequenceGame::start()
 {
+	for (auto& s : sessions)
+		if (!s->in_progress() && !s->members.empty())
+			start_session(*s);
 }
 
-static const std::string dir_name[] = { "DOWN", "LOW", "LEVEL", "HIGH", "UP" };
+void SequenceGame::start_session(GameData& sd)
+{
+	sd.clear();
+	sd.generate_sequence(std::max<size_t>(3, sd.members.size() * 2));
+
+	// one step per second, then the players repeat it
+	std::vector<BandInput::VibeAction::Cue> cues;
+	cues.reserve(sd.sequence.size());
+	for (size_t i = 0; i < sd.sequence.size(); ++i) {
+		uint64_t effect = BandInput::VibeAction::dd5_effect((int)sd.sequence[i].second);
+		cues.push_back({(uint32_t)((i + 1) * STEP_US), slots[sd.sequence[i].first].id, effect});
+	}
+	BandInput::VibeAction::playTimeline(sd.index, std::move(cues));
 
-void BandData::updatePitch(float ts, float value)
+	sd.listen_ts = BandInput::now() + (sd.sequence.size() + 1) * STEP_US;
+}
+
+void SequenceGame::update()
 {
-	if (!id)	// sentinel
-		return;
+	int64_t ts = BandInput::now();
+
+	for (auto& s : sessions) {
+		if (s->listen_ts != 0 && ts >= s->listen_ts) {
+			s->listening = true;
+			s->listen_ts = 0;
+			if (sessions.size() > 1)
+				std::cerr << "\nsession " << s->index << " MOVE!\n\n";
+			else
+				std::cerr << "\nMOVE!\n\n";
+		}
+	}
+}
+
+void SequenceGame::update_pitch(uint32_t s, int64_t ts, float value)
+{
+	BandData& bd = slots[s];
 
 	// round to nearest i/2: [-1,+1] -> [0,4]
 	float vdir = std::floor((value + 1.25f) * 2.0f);	// round to nearest n/2
@@ -167,42 +292,69 @@ void BandData::updatePitch(float ts, float value)
 	if (std::abs(diff) > 0.15f)	// between directions
 		return;
 
-	Dir dir = (Dir)((int)vdir + DOWN);
-	if (dir == cur_dir)	// unchanged
+	BandData::Dir dir = (BandData::Dir)((int)vdir + BandData::DOWN);
+	if (dir == bd.cur_dir)	// unchanged
 		return;
 
-	cur_dir = dir;
-	std::cerr << "--> " << id << " dir " << dir_name[dir - DOWN] << " (diff " << diff << ") ts " << ts << "\n";
+	bd.cur_dir = dir;
+	std::cerr << "--> " << bd.id << " dir " << dir_name[dir - BandData::DOWN] << " (diff " << diff << ") ts " << ts << "\n";
 
 	// check sequence
 
-	if (game->listening)
-		game->push_direction_change(id, ts, dir);
+	auto& sd = *sessions[bd.session];
+	if (sd.listening) {
+		sd.backlog.push(s, ts, dir);
+		mark_dirty(sd);
+	}
 }
 
-void BandData::updateTime(float ts)
+void SequenceGame::update_time(uint32_t s, int64_t ts)
 {
-	if (!id)
-		return;
-
-	game->advance_time(id, ts);
+	auto& sd = *sessions[slots[s].session];
+	sd.backlog.advance(s, ts);
+	if (sd.listening && !sd.backlog.empty())
+		mark_dirty(sd);
 }
 
 void GameData::clear()
 {
 	sequence.clear();
-	backlog.clear();
+	backlog.clear_events();
 	current = missed = 0;
 	listening = false;
-	start_ts = float_ts();
+	listen_ts = 0;
+	start_ts = BandInput::now();
+
+	game.free_slots.insert(game.free_slots.end(), retired.begin(), retired.end());
+	retired.clear();
 }
 
-void GameData::generate_sequence(const std::vector<unsigned>& ids, size_t n)
+// the band of the slot left: the round goes on without its steps
+void GameData::drop(uint32_t slot)
 {
-	std::uniform_int_distribution<size_t> idgen(0, ids.size() - 1);
+	if (!in_progress())
+		return;
+
+	sequence.erase(std::remove_if(sequence.begin() + current, sequence.end(), [slot] (const auto& sp) {
+		return sp.first == slot;
+	}), sequence.end());
+	if (in_progress())
+		return;
+
+	BandInput::VibeAction::cancelTimeline(index);
+	listen_ts = 0;
+	if (listening) {
+		listening = false;
+		std::cerr << "\nFINISHED!\n\nlength " << sequence.size() << "  missed " << missed << "  time " << (BandInput::now() - start_ts) / 1e6 << "\n\n";
+	}
+}
+
+void GameData::generate_sequence(size_t n)
+{
+	std::uniform_int_distribution<size_t> idgen(0, members.size() - 1);
 	std::uniform_int_distribution<int> dirgen(BandData::DOWN, BandData::UP);
 
-	std::vector<bool> seen_id(ids.size(), false);
+	std::vector<bool> seen_id(members.size(), false);
 	std::decay_t<decltype(sequence.front())> prev;
 	prev.first = ~0;
 
@@ -212,12 +364,12 @@ void GameData::generate_sequence(const std::vector<unsigned>& ids, size_t n)
 		size_t ididx;
 		for (;;) {
 			ididx = idgen(rd);
-			sp.first = ids[ididx];
+			sp.first = members[ididx];
 			sp.second = (BandData::Dir)dirgen(rd);
 			if (sp == prev)
 				continue;
 			if (!seen_id[ididx]) {
-				if (sp.second == game.band(sp.first).cur_dir)
+				if (sp.second == game.slots[sp.first].cur_dir)
 					continue;
 				seen_id[ididx] = true;
 			}
@@ -225,16 +377,10 @@ void GameData::generate_sequence(const std::vector<unsigned>& ids, size_t n)
 		}
 		prev = sp;
 
-		std::cerr << "SEQ#" << ++i << "  " << sp.first << " " << dir_name[sp.second - BandData::DOWN] << '\n';
+		std::cerr << "SEQ#" << ++i << "  " << band_id(sp.first) << " " << dir_name[sp.second - BandData::DOWN] << '\n';
 	}
 }
 
-void GameData::push_direction_change(unsigned id, float ts, BandData::Dir dir)
-{
-	backlog[ts].emplace_back(id, dir);
-	advance_time(id, ts);
-}
-
 static void signal_band(unsigned id, bool ok)
 {
 	uint64_t effect;
@@ -246,38 +392,39 @@ static void signal_band(unsigned id, bool ok)
 	BandInput::VibeAction::trigger(id, effect);
 }
 
-void GameData::advance_time(unsigned id, float ts)
+void GameData::evaluate()
 {
-	band_ts[id] = ts;
-
 	if (!listening)
 		return;
 
-	ts = std::min_element(band_ts.begin(), band_ts.end(), [] (const auto& a, const auto& b) { return a.second < b.second; })->second;
-	std::map<unsigned, bool> signal;
-
-	while (!backlog.empty() && backlog.begin()->first <= ts) {
-		for (const auto& banddir : backlog.begin()->second) {
-			bool b = test_sequence(banddir.first, banddir.second);
-			signal[banddir.first] = b;
-		}
-		backlog.erase(backlog.begin());
-	}
+	// only the last verdict per band is signalled
+	signal.clear();
+	backlog.release([this] (uint32_t slot, int64_t, BandData::Dir dir) {
+		if (!in_progress())
+			return;
+		bool b = test_sequence(slot, dir);
+		auto p = std::find_if(signal.begin(), signal.end(), [slot] (const auto& s) { return s.first == slot; });
+		if (p != signal.end())
+			p->second = b;
+		else
+			signal.emplace_back(slot, b);
+	});
 
 	for (auto bsig : signal)
-		signal_band(bsig.first, bsig.second);
+		if (band_id(bsig.first))
+			signal_band(band_id(bsig.first), bsig.second);
 
 	if (!listening)
-		std::cerr << "\nFINISHED!\n\nlength " << sequence.size() << "  missed " << missed << "  time " << (float_ts() - start_ts) << "\n\n";
+		std::cerr << "\nFINISHED!\n\nlength " << sequence.size() << "  missed " << missed << "  time " << (BandInput::now() - start_ts) / 1e6 << "\n\n";
 }
 
-bool GameData::test_sequence(unsigned id, BandData::Dir dir)
+bool GameData::test_sequence(uint32_t slot, BandData::Dir dir)
 {
-	bool ok = sequence[current] == std::make_pair(id, dir);
+	bool ok = sequence[current] == std::make_pair(slot, dir);
 
 	char buf[128];
 	buf[127] = 0;
-	snprintf(buf, sizeof(buf) - 1, "seq #%zu  %s  (%u, %d)\n", current, ok ? "accepted" : "MISSED", id, dir);
+	snprintf(buf, sizeof(buf) - 1, "seq #%zu  %s  (%u, %d)\n", current, ok ? "accepted" : "MISSED", band_id(slot), dir);
 	std::cerr << buf;
 
 	if (ok) {
@@ -1,52 +1,88 @@
 #ifndef __HELLOWORLD_GAME_H__
 #define __HELLOWORLD_GAME_H__
 
-#include <deque>
-#include <map>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
-namespace cocos2d { class Node; }
+#include "BandInput.h"
 
 class SequenceGame;
-class GameData;
+struct GameData;
 
+// what the game shows of its bands, see SequenceGame::processBatch()
+struct SequenceDisplay
+{
+	virtual ~SequenceDisplay() = default;
+
+	// false keeps the band out of the game
+	virtual bool addBand(unsigned id) = 0;
+	virtual void removeBand(unsigned id) = 0;
+	virtual void updateBandPitch(unsigned id, float value) = 0;
+};
+
+// per band state, kept in a dense slot array
 struct BandData
 {
 	enum Dir { DOWN = -2, LOW, LEVEL, HIGH, UP };
 
-	GameData *const game;
-	const unsigned id;
+	unsigned id;		// 0: free slot
+	unsigned session;
 	Dir cur_dir;
-	cocos2d::Node *arrow;
-
-	BandData(GameData& game, unsigned id);
-	BandData();
-
-	void updatePitch(float ts, float value);
-	void updateTime(float ts);
 };
 
+// Bands are partitioned into sessions of up to session_size bands, each
+// playing its own round. Records are fed per band span and every session
+// with pending direction changes is evaluated once per frame in flush().
 class SequenceGame
 {
-	friend class BandData;
-	friend class GameData;
+	friend struct GameData;
+
+	std::vector<BandData> slots;
+	std::vector<uint32_t> free_slots;
+	std::unordered_map<unsigned, uint32_t> slot_index;	// band id -> slot
 
-	std::map<unsigned, BandData> bands;
-	std::unique_ptr<GameData> data;
-	float start_ts;
+	std::vector<std::unique_ptr<GameData>> sessions;
+	std::vector<unsigned> dirty;	// sessions to evaluate in flush()
+	size_t session_size;
 
-	BandData& band(unsigned id) noexcept;
+	static constexpr uint32_t NO_SLOT = ~(uint32_t)0;
+
+	uint32_t slot(unsigned id) const noexcept;
+	unsigned assign_session();
+	void update_pitch(uint32_t slot, int64_t ts, float value);
+	void update_time(uint32_t slot, int64_t ts);
+	void mark_dirty(GameData& s);
+	void settle();
+	void start_session(GameData& s);
 public:
-	SequenceGame();
+	// 0 puts every band in a single session
+	explicit SequenceGame(size_t session_size_ = 0);
 	~SequenceGame();
 
-	void addBand(unsigned id, cocos2d::Node *arrow);
+	// BANDGAME_SESSION_SIZE, 0 if unset
+	static size_t envSessionSize();
+
+	void addBand(unsigned id);
 	void removeBand(unsigned id);
-	void updateBandPitch(unsigned id, float ts, float value);
-	void updateBandTime(unsigned id, float ts);
+
+	// PITCH, RAW and TIME records of one band
+	void processSpan(const BandInput::EventSpan& span);
+	// evaluates the direction changes collected since the last call
+	void flush();
+
+	// a frame of band records: adds and removes the bands around their spans,
+	// then flushes; display, if any, sees the bands first
+	void processBatch(const BandInput::Batch& batch, SequenceDisplay *display = nullptr);
+
+	// starts every session that isn't playing
 	void start();
 	void update();
 
+	size_t sessionCount() const { return sessions.size(); }
+	size_t bandCount() const { return slot_index.size(); }
+
 	auto cb() { return [this] (float d) { update(); }; }
 };
 
@@ -0,0 +1,133 @@
+#ifndef BANDGAME_SLOT_MAP_H_
+#define BANDGAME_SLOT_MAP_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Owning map from generation-checked ids to objects. An id holds its slot
+// index + 1 in the low SLOT_BITS and the slot's generation above, so an id
+// that outlived its object never finds the one that reused the slot.
+// insert(), remove() and find() are O(1); for_each() visits the slots in
+// index order, which doesn't change while an object lives.
+//
+// Writers, and readers that dereference what find() returns, are serialized
+// by the owner. live() may be called from any thread without that: slots
+// are allocated in chunks that stay put until the map goes, and a slot's
+// tag is atomic.
+template <typename T>
+class SlotMap
+{
+public:
+	static constexpr unsigned SLOT_BITS = 16;
+	static constexpr size_t CAPACITY = (1u << SLOT_BITS) - 1;
+
+	static size_t slot_of(unsigned id) noexcept { return (id & CAPACITY) - 1; }
+private:
+	static constexpr unsigned CHUNK_BITS = 8;
+	static constexpr size_t CHUNK = 1u << CHUNK_BITS;
+
+	struct Slot
+	{
+		std::atomic<unsigned> tag{0};	// id of the object, 0 if free
+		uint16_t gen = 0;
+		std::unique_ptr<T> obj;
+	};
+
+	struct Chunk
+	{
+		Slot slots[CHUNK];
+	};
+
+	std::atomic<Chunk *> chunks[(CAPACITY + CHUNK) / CHUNK];
+	std::vector<size_t> free_slots;
+	size_t used, count;	// slots handed out so far, objects
+
+	Slot *slot(size_t i) const noexcept
+	{
+		if (i >= CAPACITY)
+			return nullptr;
+		Chunk *c = chunks[i >> CHUNK_BITS].load(std::memory_order_acquire);
+		return c ? &c->slots[i & (CHUNK - 1)] : nullptr;
+	}
+public:
+	SlotMap() : used(0), count(0)
+	{
+		for (auto& c : chunks)
+			c.store(nullptr, std::memory_order_relaxed);
+	}
+
+	~SlotMap()
+	{
+		for (auto& c : chunks)
+			delete c.load(std::memory_order_relaxed);
+	}
+
+	SlotMap(const SlotMap&) = delete;
+	SlotMap& operator=(const SlotMap&) = delete;
+
+	// returns the new id; 0 when full, obj is left alone then
+	unsigned insert(std::unique_ptr<T>&& obj)
+	{
+		size_t i;
+		if (!free_slots.empty()) {
+			i = free_slots.back();
+			free_slots.pop_back();
+		} else {
+			if (used == CAPACITY)
+				return 0;
+			i = used++;
+			auto& c = chunks[i >> CHUNK_BITS];
+			if (!c.load(std::memory_order_relaxed))
+				c.store(new Chunk, std::memory_order_release);
+		}
+
+		Slot& s = *slot(i);
+		unsigned id = (unsigned)++s.gen << SLOT_BITS | (unsigned)(i + 1);
+		s.obj = std::move(obj);
+		s.tag.store(id, std::memory_order_release);
+		++count;
+		return id;
+	}
+
+	// hands the object back, null if id is stale
+	std::unique_ptr<T> remove(unsigned id)
+	{
+		Slot *s = slot(slot_of(id));
+		if (!s || s->tag.load(std::memory_order_relaxed) != id)
+			return nullptr;
+
+		s->tag.store(0, std::memory_order_release);
+		free_slots.push_back(slot_of(id));
+		--count;
+		return std::move(s->obj);
+	}
+
+	T *find(unsigned id) const noexcept
+	{
+		Slot *s = slot(slot_of(id));
+		return s && s->tag.load(std::memory_order_acquire) == id ? s->obj.get() : nullptr;
+	}
+
+	bool live(unsigned id) const noexcept
+	{
+		Slot *s = slot(slot_of(id));
+		return s && s->tag.load(std::memory_order_acquire) == id;
+	}
+
+	template <typename F>
+	void for_each(F&& f) const
+	{
+		for (size_t i = 0; i < used; ++i) {
+			Slot *s = slot(i);
+			if (s->tag.load(std::memory_order_relaxed))
+				f(*s->obj);
+		}
+	}
+
+	size_t size() const noexcept { return count; }
+};
+
+#endif /* BANDGAME_SLOT_MAP_H_ */
@@ -0,0 +1,99 @@
+#ifndef BANDGAME_SPSC_QUEUE_H_
+#define BANDGAME_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// Fixed-capacity single-producer/single-consumer ring.
+// Producer and consumer never block nor allocate after construction.
+template <typename T>
+class SpscQueue
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SpscQueue holds POD records only");
+
+	static constexpr size_t CACHELINE = 64;
+
+	alignas(CACHELINE) std::atomic<size_t> head;	// written by producer
+	size_t tail_cache;
+	alignas(CACHELINE) std::atomic<size_t> tail;	// written by consumer
+	size_t head_cache;
+	alignas(CACHELINE) std::atomic<uint64_t> overflows;
+
+	const size_t mask;
+	std::unique_ptr<T[]> ring;
+
+	static size_t round_up(size_t n)
+	{
+		size_t v = 1;
+		while (v < n)
+			v <<= 1;
+		return v;
+	}
+public:
+	explicit SpscQueue(size_t capacity)
+		: head(0), tail_cache(0), tail(0), head_cache(0), overflows(0),
+		  mask(round_up(capacity) - 1), ring(new T[mask + 1])
+	{
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	size_t capacity() const noexcept { return mask + 1; }
+
+	// producer side; fails (and counts an overflow) if less than
+	// `reserve` slots would remain free after the push
+	bool push(const T& v, size_t reserve = 0) noexcept
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail_cache + reserve >= capacity()) {
+			tail_cache = tail.load(std::memory_order_acquire);
+			if (h - tail_cache + reserve >= capacity()) {
+				overflows.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+		}
+
+		ring[h & mask] = v;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// producer side; number of free slots
+	size_t writable() noexcept
+	{
+		tail_cache = tail.load(std::memory_order_acquire);
+		return capacity() - (head.load(std::memory_order_relaxed) - tail_cache);
+	}
+
+	// consumer side; number of records ready to be popped
+	size_t readable() noexcept
+	{
+		head_cache = head.load(std::memory_order_acquire);
+		return head_cache - tail.load(std::memory_order_relaxed);
+	}
+
+	// consumer side; returns nullptr when empty, the record stays valid until pop()
+	T *front() noexcept
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head_cache) {
+			head_cache = head.load(std::memory_order_acquire);
+			if (t == head_cache)
+				return nullptr;
+		}
+		return &ring[t & mask];
+	}
+
+	void pop() noexcept
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	uint64_t overflowCount() const noexcept { return overflows.load(std::memory_order_relaxed); }
+};
+
+#endif /* BANDGAME_SPSC_QUEUE_H_ */
@@ -0,0 +1,250 @@
+#ifndef BANDGAME_WATERMARK_MERGER_H_
+#define BANDGAME_WATERMARK_MERGER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// k-way merge of timestamped events coming from several streams. Each
+// stream reports how far it got (its watermark); events are released in
+// timestamp order once every live stream has passed them. A stream's
+// watermark never goes back; events pushed below it are moved up to it.
+// Updates and releases are O(log streams).
+template <typename T>
+class WatermarkMerger
+{
+	static constexpr size_t RING_INIT = 16;
+	static constexpr size_t NONE = ~(size_t)0;
+
+	struct Entry
+	{
+		int64_t ts;
+		uint64_t seq;	// keeps events with equal timestamps in push order
+		T value;
+	};
+
+	struct Stream
+	{
+		unsigned id;
+		bool live;
+		int64_t watermark;
+		size_t wm_pos, head_pos;	// positions in the heaps, NONE if absent
+
+		// ring of pending events, power-of-two size
+		std::vector<Entry> ring;
+		size_t head, count;
+
+		const Entry& front() const { return ring[head]; }
+	};
+
+	std::vector<Stream> streams;
+	std::vector<size_t> free_slots;
+	std::unordered_map<unsigned, size_t> index;
+
+	// binary min-heaps of stream slots: by watermark, and by first pending event
+	std::vector<size_t> wm_heap, head_heap;
+	uint64_t next_seq;
+
+	bool wm_less(size_t a, size_t b) const
+	{
+		return streams[a].watermark < streams[b].watermark;
+	}
+
+	bool head_less(size_t a, size_t b) const
+	{
+		const Entry& x = streams[a].front();
+		const Entry& y = streams[b].front();
+		return x.ts < y.ts || (x.ts == y.ts && x.seq < y.seq);
+	}
+
+	template <size_t Stream::*Pos, bool (WatermarkMerger::*Less)(size_t, size_t) const>
+	void sift(std::vector<size_t>& heap, size_t i)
+	{
+		// up
+		while (i) {
+			size_t parent = (i - 1) / 2;
+			if (!(this->*Less)(heap[i], heap[parent]))
+				break;
+			std::swap(heap[i], heap[parent]);
+			streams[heap[i]].*Pos = i;
+			streams[heap[parent]].*Pos = parent;
+			i = parent;
+		}
+		// down
+		for (;;) {
+			size_t l = 2 * i + 1, r = l + 1, m = i;
+			if (l < heap.size() && (this->*Less)(heap[l], heap[m]))
+				m = l;
+			if (r < heap.size() && (this->*Less)(heap[r], heap[m]))
+				m = r;
+			if (m == i)
+				break;
+			std::swap(heap[i], heap[m]);
+			streams[heap[i]].*Pos = i;
+			streams[heap[m]].*Pos = m;
+			i = m;
+		}
+	}
+
+	template <size_t Stream::*Pos, bool (WatermarkMerger::*Less)(size_t, size_t) const>
+	void heap_insert(std::vector<size_t>& heap, size_t slot)
+	{
+		streams[slot].*Pos = heap.size();
+		heap.push_back(slot);
+		sift<Pos, Less>(heap, heap.size() - 1);
+	}
+
+	template <size_t Stream::*Pos, bool (WatermarkMerger::*Less)(size_t, size_t) const>
+	void heap_erase(std::vector<size_t>& heap, size_t slot)
+	{
+		size_t i = streams[slot].*Pos;
+		streams[slot].*Pos = NONE;
+		size_t last = heap.back();
+		heap.pop_back();
+		if (last == slot)
+			return;
+		heap[i] = last;
+		streams[last].*Pos = i;
+		sift<Pos, Less>(heap, i);
+	}
+
+	size_t stream(unsigned id, int64_t ts)
+	{
+		auto p = index.emplace(id, 0);
+		if (!p.second)
+			return p.first->second;
+
+		size_t slot;
+		if (free_slots.empty()) {
+			slot = streams.size();
+			streams.emplace_back();
+			streams[slot].ring.resize(RING_INIT);
+		} else {
+			slot = free_slots.back();
+			free_slots.pop_back();
+		}
+
+		Stream& s = streams[slot];
+		s.id = id;
+		s.live = true;
+		s.watermark = ts;
+		s.head = s.count = 0;
+		s.head_pos = NONE;
+		heap_insert<&Stream::wm_pos, &WatermarkMerger::wm_less>(wm_heap, slot);
+
+		p.first->second = slot;
+		return slot;
+	}
+public:
+	WatermarkMerger() : next_seq(0) {}
+
+	// the lowest watermark of all live streams, INT64_MAX when there is none
+	int64_t watermark() const
+	{
+		return wm_heap.empty() ? std::numeric_limits<int64_t>::max() : streams[wm_heap.front()].watermark;
+	}
+
+	bool empty() const
+	{
+		return head_heap.empty();
+	}
+
+	size_t pending() const
+	{
+		size_t n = 0;
+		for (size_t slot : head_heap)
+			n += streams[slot].count;
+		return n;
+	}
+
+	// also advances the stream to `ts`
+	void push(unsigned id, int64_t ts, const T& value)
+	{
+		size_t slot = stream(id, ts);
+		Stream& s = streams[slot];
+		if (ts < s.watermark)
+			ts = s.watermark;
+
+		if (s.count == s.ring.size()) {
+			std::vector<Entry> bigger(s.ring.size() * 2);
+			for (size_t i = 0; i < s.count; ++i)
+				bigger[i] = s.ring[(s.head + i) & (s.ring.size() - 1)];
+			s.ring.swap(bigger);
+			s.head = 0;
+		}
+		s.ring[(s.head + s.count) & (s.ring.size() - 1)] = Entry{ts, next_seq++, value};
+		if (!s.count++)
+			heap_insert<&Stream::head_pos, &WatermarkMerger::head_less>(head_heap, slot);
+
+		advance(id, ts);
+	}
+
+	void advance(unsigned id, int64_t ts)
+	{
+		size_t slot = stream(id, ts);
+		Stream& s = streams[slot];
+		if (!s.live || ts <= s.watermark)
+			return;
+		s.watermark = ts;
+		sift<&Stream::wm_pos, &WatermarkMerger::wm_less>(wm_heap, s.wm_pos);
+	}
+
+	// the stream no longer holds back the watermark; its pending events stay
+	void remove(unsigned id)
+	{
+		auto p = index.find(id);
+		if (p == index.end())
+			return;
+
+		size_t slot = p->second;
+		index.erase(p);
+		streams[slot].live = false;
+		heap_erase<&Stream::wm_pos, &WatermarkMerger::wm_less>(wm_heap, slot);
+		if (!streams[slot].count)
+			free_slots.push_back(slot);
+	}
+
+	// calls f(id, ts, value) for every event at or below the watermark, oldest first;
+	// f may push more events, they are released in the same call if they qualify
+	template <typename F>
+	void release(F&& f)
+	{
+		while (!head_heap.empty()) {
+			size_t slot = head_heap.front();
+			Stream& s = streams[slot];
+			if (s.front().ts > watermark())
+				break;
+
+			Entry e = s.front();
+			unsigned id = s.id;
+			s.head = (s.head + 1) & (s.ring.size() - 1);
+			if (--s.count) {
+				sift<&Stream::head_pos, &WatermarkMerger::head_less>(head_heap, 0);
+			} else {
+				heap_erase<&Stream::head_pos, &WatermarkMerger::head_less>(head_heap, slot);
+				if (!s.live)
+					free_slots.push_back(slot);
+			}
+
+			f(id, e.ts, e.value);
+		}
+	}
+
+	// drops pending events, keeps the streams and their watermarks
+	void clear_events()
+	{
+		for (size_t slot : head_heap) {
+			Stream& s = streams[slot];
+			s.head = s.count = 0;
+			s.head_pos = NONE;
+			if (!s.live)
+				free_slots.push_back(slot);
+		}
+		head_heap.clear();
+	}
+};
+
+#endif /* BANDGAME_WATERMARK_MERGER_H_ */
@@ -0,0 +1,64 @@
+// Round trip through BandLogWriter/BandLogReader: every record reads back
+// as written, host times relative to the first record.
+//
+// usage: band_log_check [log path]
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "BandLog.h"
+
+int main(int argc, char **argv)
+{
+	std::string path = argc > 1 ? argv[1] : "band_log_check.bndlog";
+	const uint64_t t0 = 123456789012;	// an arbitrary steady_clock reading [us]
+	std::vector<SensorData> data(64);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i].timestamp = 1000000 + i * 10000;
+		data[i].v.ax = (int)i * 7 - 200;
+		data[i].v.gz = 300 - (int)i * 11;
+	}
+
+	try {
+		{
+			BandLogWriter log(path);
+			log.arrival(3, t0, "band", 42, DevIdData());
+			log.samples(3, t0 + 500, data.data(), data.size());
+			log.removal(3, t0 + 2000);
+		}
+
+		BandLogReader log(path);
+		BandLogReader::Record rec;
+		size_t n = 0, i = 0;
+		int failed = 0;
+		while (log.next(rec)) {
+			uint64_t want = n == 0 ? 0 : rec.type == BandLogReader::Record::REMOVAL ? 2000 : 500;
+			if (rec.host_us != want) {
+				fprintf(stderr, "record %zu: host time %llu, expected %llu\n", n,
+					(unsigned long long)rec.host_us, (unsigned long long)want);
+				failed = 1;
+			}
+			if (rec.type == BandLogReader::Record::SAMPLE) {
+				const SensorData& d = data[i++];
+				if (rec.sample.timestamp != d.timestamp || rec.sample.v.ax != d.v.ax || rec.sample.v.gz != d.v.gz) {
+					fprintf(stderr, "sample %zu doesn't match\n", i - 1);
+					failed = 1;
+				}
+			}
+			++n;
+		}
+		if (n != data.size() + 2) {
+			fprintf(stderr, "%zu records, expected %zu\n", n, data.size() + 2);
+			failed = 1;
+		}
+		remove(path.c_str());
+		printf("%s\n", failed ? "FAILED" : "ok");
+		return failed;
+	} catch (const std::exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,113 @@
+// Ordering direction changes of many bands by timestamp: the former
+// std::map backlog with a min_element scan per sample vs WatermarkMerger.
+//
+// usage: band_merge_bench [bands] [samples per band] [samples per change]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "WatermarkMerger.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+struct Sample
+{
+	unsigned id;
+	int64_t ts;	// [us]
+	bool change;
+};
+
+// bands report at the same rate with their own clock jitter; samples reach
+// the game out of timestamp order across bands, in order within a band
+static std::vector<Sample> synth_stream(unsigned bands, size_t per_band, unsigned change_every)
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int64_t> jitter(0, 4000), delay(0, 20000);
+	std::uniform_int_distribution<unsigned> change(0, change_every - 1);
+	std::vector<int64_t> ts(bands, 0), arrival(bands, 0);
+	std::vector<std::pair<int64_t, Sample>> v;
+	v.reserve(bands * per_band);
+
+	for (size_t i = 0; i < per_band; ++i)
+		for (unsigned b = 0; b < bands; ++b) {
+			ts[b] += 10000 + jitter(rng);
+			arrival[b] = std::max(arrival[b], ts[b] + delay(rng));
+			v.emplace_back(arrival[b], Sample{b + 1, ts[b], !change(rng)});
+		}
+
+	std::stable_sort(v.begin(), v.end(), [] (const auto& a, const auto& b) { return a.first < b.first; });
+
+	std::vector<Sample> out;
+	out.reserve(v.size());
+	for (auto& p : v)
+		out.push_back(p.second);
+	return out;
+}
+
+template <typename F>
+static double run_ns_per_sample(size_t n, F&& f)
+{
+	auto t0 = bench_clock::now();
+	f();
+	auto t1 = bench_clock::now();
+	return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned bands = argc > 1 ? strtoul(argv[1], nullptr, 0) : 64;
+	size_t per_band = argc > 2 ? strtoul(argv[2], nullptr, 0) : 20000;
+	unsigned change_every = argc > 3 ? strtoul(argv[3], nullptr, 0) : 20;
+	if (!bands || !change_every)
+		return 1;
+
+	auto stream = synth_stream(bands, per_band, change_every);
+	size_t n = stream.size();
+	uint64_t released_map = 0, released_merger = 0;
+
+	double legacy = run_ns_per_sample(n, [&] {
+		std::map<int64_t, std::vector<std::pair<unsigned, int>>> backlog;
+		std::map<unsigned, int64_t> band_ts;
+
+		for (auto& s : stream) {
+			if (s.change)
+				backlog[s.ts].emplace_back(s.id, 1);
+			band_ts[s.id] = s.ts;
+
+			int64_t ts = std::min_element(band_ts.begin(), band_ts.end(), [] (const auto& a, const auto& b) { return a.second < b.second; })->second;
+			std::map<unsigned, bool> signal;
+			while (!backlog.empty() && backlog.begin()->first <= ts) {
+				for (const auto& banddir : backlog.begin()->second)
+					signal[banddir.first] = true;
+				released_map += backlog.begin()->second.size();
+				backlog.erase(backlog.begin());
+			}
+		}
+	});
+
+	double merged = run_ns_per_sample(n, [&] {
+		WatermarkMerger<int> backlog;
+
+		for (auto& s : stream) {
+			if (s.change)
+				backlog.push(s.id, s.ts, 1);
+			else
+				backlog.advance(s.id, s.ts);
+			backlog.release([&] (unsigned, int64_t, int) { ++released_merger; });
+		}
+	});
+
+	printf("bands %u  samples %zu  changes released %llu / %llu\n", bands, n,
+	       (unsigned long long)released_map, (unsigned long long)released_merger);
+	printf("map + min_element  %7.1f ns/sample\n", legacy);
+	printf("watermark merger   %7.1f ns/sample  (x%.1f)\n", merged, legacy / merged);
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+// SequenceGame without a window: the Director's scheduler, action manager
+// and event dispatcher are stepped with a fixed timestep and no GL context,
+// fed by simulated bands (BANDGAME_SYNTH, default bands=64) or a recorded
+// session (BANDGAME_REPLAY). Reports delivered events/s, the logic time
+// per frame and the heap allocations made per frame on the game thread.
+//
+// usage: headless_game [seconds] [fps] [pace]
+//   pace 0 steps the frames back to back instead of at the frame rate
+//   BANDGAME_SESSION_SIZE as in the game, default 0: a single session
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "cocos2d.h"
+#include "BandInput.h"
+#include "SequenceGame.h"
+
+USING_NS_CC;
+
+using bench_clock = std::chrono::steady_clock;
+
+static std::atomic<uint64_t> total_allocs{0};
+static thread_local uint64_t thread_allocs = 0;
+
+static void *counted_alloc(size_t n) noexcept
+{
+	total_allocs.fetch_add(1, std::memory_order_relaxed);
+	++thread_allocs;
+	return malloc(n ? n : 1);
+}
+
+void *operator new(size_t n)
+{
+	void *p = counted_alloc(n);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t n)
+{
+	return operator new(n);
+}
+
+void *operator new(size_t n, const std::nothrow_t&) noexcept
+{
+	return counted_alloc(n);
+}
+
+void *operator new[](size_t n, const std::nothrow_t&) noexcept
+{
+	return counted_alloc(n);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+struct FrameStats
+{
+	uint32_t logic_ns;
+	uint32_t allocs;
+	uint32_t records;
+};
+
+static double percentile(std::vector<uint32_t>& v, double p)
+{
+	if (v.empty())
+		return 0;
+	size_t i = std::min(v.size() - 1, (size_t)(v.size() * p / 100));
+	std::nth_element(v.begin(), v.begin() + i, v.end());
+	return v[i];
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = argc > 1 ? strtod(argv[1], nullptr) : 30;
+	unsigned fps = argc > 2 ? strtoul(argv[2], nullptr, 0) : 60;
+	bool pace = argc > 3 ? atoi(argv[3]) != 0 : true;
+	if (!(seconds > 0) || !fps)
+		return 1;
+
+	if (!getenv("BANDGAME_REPLAY"))
+		setenv("BANDGAME_SYNTH", "bands=64", 0);
+
+	// Director::init() sets up the scheduler, actions and events; GL is only touched by a GLView
+	auto director = Director::getInstance();
+	auto scheduler = director->getScheduler();
+	auto& evd = *director->getEventDispatcher();
+	auto& input = BandInput::getInstance();
+
+	auto game = std::make_shared<SequenceGame>(SequenceGame::envSessionSize());
+	uint64_t records = 0;
+
+	// the game's own listener, without a display
+	auto evl = BandInput::Event::createBatchListener([&] (BandInput::Batch *batch) {
+		for (auto& span : *batch)
+			records += span.count;
+		game->processBatch(*batch);
+	});
+	evd.addEventListenerWithFixedPriority(evl, 1);
+
+	BandInput::EventFilter filter;
+	filter.raw = BandInput::EventFilter::RAW_HEARTBEAT;
+	filter.n = 8;
+	input.setEventFilter(0, filter);
+
+	scheduler->schedule(game->cb(), game.get(), 0, false, "game");
+
+	const float dt = 1.0f / fps;
+	const auto period = std::chrono::duration_cast<bench_clock::duration>(std::chrono::duration<double>(dt));
+	size_t frames = (size_t)(seconds * fps);
+	std::vector<FrameStats> stats;
+	stats.reserve(frames);
+
+	auto t0 = bench_clock::now();
+	auto deadline = t0;
+	for (size_t f = 0; f < frames; ++f) {
+		// give the bands a second to show up before the first rounds
+		if (f >= fps)
+			game->start();
+
+		uint64_t records0 = records, allocs0 = thread_allocs;
+		auto begin = bench_clock::now();
+		input.checkEvents(evd);
+		scheduler->update(dt);
+		auto end = bench_clock::now();
+
+		stats.push_back(FrameStats{(uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count(),
+		                           (uint32_t)(thread_allocs - allocs0), (uint32_t)(records - records0)});
+
+		if (pace) {
+			deadline += period;
+			std::this_thread::sleep_until(deadline);
+		}
+	}
+	double wall = std::chrono::duration<double>(bench_clock::now() - t0).count();
+
+	std::vector<uint32_t> logic, allocs;
+	uint64_t logic_total = 0, allocs_total = 0;
+	uint32_t records_max = 0;
+	for (auto& s : stats) {
+		logic.push_back(s.logic_ns);
+		allocs.push_back(s.allocs);
+		logic_total += s.logic_ns;
+		allocs_total += s.allocs;
+		records_max = std::max(records_max, s.records);
+	}
+
+	printf("frames %zu  wall %.2f s  bands %zu  sessions %zu\n", frames, wall, game->bandCount(), game->sessionCount());
+	printf("events    %llu  %.0f /s  max %u /frame\n", (unsigned long long)records, records / wall, records_max);
+	printf("logic     mean %.1f  p50 %.1f  p99 %.1f  max %.1f us/frame  (%.1f ns/event)\n",
+	       logic_total / 1e3 / frames, percentile(logic, 50) / 1e3, percentile(logic, 99) / 1e3, percentile(logic, 100) / 1e3,
+	       records ? (double)logic_total / records : 0.0);
+	printf("allocs    mean %.1f  p99 %.0f  max %.0f /frame on the game thread, %llu total in all threads\n",
+	       (double)allocs_total / frames, percentile(allocs, 99), percentile(allocs, 100),
+	       (unsigned long long)total_allocs.load(std::memory_order_relaxed));
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+// Scene graph visit on the render workers vs the serial visit: a scene of
+// independent subtrees whose transforms change every frame, visited with
+// 0, 1, 2, 4... worker threads. Checks that the queued command order is
+// the same as in the serial visit. Needs no GL context.
+//
+// usage: parallel_visit_bench [subtrees] [fan-out] [frames]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "cocos2d.h"
+#include "renderer/CCRenderWorkers.h"
+
+USING_NS_CC;
+
+using bench_clock = std::chrono::steady_clock;
+
+// stands in for a sprite: culls its quad and queues one command
+class BenchNode : public Node
+{
+public:
+	CREATE_FUNC(BenchNode);
+
+	virtual void draw(Renderer *renderer, const Mat4& transform, uint32_t flags) override
+	{
+		Vec3 corners[4] = { {0, 0, 0}, {_contentSize.width, 0, 0}, {0, _contentSize.height, 0}, {_contentSize.width, _contentSize.height, 0} };
+		float minx = 1e9f, maxx = -1e9f;
+		for (auto& c : corners) {
+			transform.transformPoint(&c);
+			minx = std::min(minx, c.x);
+			maxx = std::max(maxx, c.x);
+		}
+		if (maxx < -1e6f || minx > 1e6f)
+			return;
+
+		_command.init(_globalZOrder, transform, flags);
+		renderer->addCommand(&_command);
+	}
+private:
+	CustomCommand _command;
+};
+
+// exposes the default queue to compare command orders
+struct InspectRenderer : public Renderer
+{
+	std::vector<RenderCommand*> order()
+	{
+		std::vector<RenderCommand*> v;
+		auto& q = _renderGroups[0];
+		for (int g = 0; g < RenderQueue::QUEUE_COUNT; ++g) {
+			auto& sub = q.getSubQueue((RenderQueue::QUEUE_GROUP)g);
+			v.insert(v.end(), sub.begin(), sub.end());
+		}
+		return v;
+	}
+};
+
+int main(int argc, char **argv)
+{
+	unsigned subtrees = argc > 1 ? strtoul(argv[1], nullptr, 0) : 64;
+	unsigned fan = argc > 2 ? strtoul(argv[2], nullptr, 0) : 32;
+	unsigned frames = argc > 3 ? strtoul(argv[3], nullptr, 0) : 200;
+	if (!subtrees || !fan || !frames)
+		return 1;
+
+	Director::getInstance();
+	// never deleted, its destructor releases GL buffers
+	auto renderer = new InspectRenderer;
+
+	auto root = Node::create();
+	root->retain();
+	root->setVisitChildrenInParallel(true);
+
+	std::vector<Node *> groups;
+	for (unsigned g = 0; g < subtrees; ++g) {
+		auto group = Node::create();
+		group->setPosition(g * 3.0f, g * 2.0f);
+		for (unsigned i = 0; i < fan; ++i) {
+			auto mid = BenchNode::create();
+			mid->setContentSize(Size(8, 8));
+			mid->setPosition(i, -(float)i);
+			for (unsigned j = 0; j < fan; ++j) {
+				auto leaf = BenchNode::create();
+				leaf->setContentSize(Size(4, 4));
+				leaf->setPosition(j * 0.5f, j * 0.25f);
+				leaf->setRotation(j);
+				mid->addChild(leaf, (int)(j % 3) - 1);
+			}
+			group->addChild(mid, (int)(i % 5) - 2);
+		}
+		root->addChild(group, (int)(g % 3) - 1);
+		groups.push_back(group);
+	}
+	size_t nodes = 1 + subtrees * (1 + fan + (size_t)fan * fan);
+
+	std::vector<unsigned> counts = { 0, 1 };
+	for (unsigned n = 2; n < std::thread::hardware_concurrency(); n *= 2)
+		counts.push_back(n);
+	if (counts.back() + 1 < std::thread::hardware_concurrency())
+		counts.push_back(std::thread::hardware_concurrency() - 1);
+
+	printf("nodes %zu  subtrees %u  frames %u\n", nodes, subtrees, frames);
+
+	std::vector<RenderCommand*> serial;
+	double base = 0;
+	for (unsigned threads : counts) {
+		renderer->setWorkerThreads(threads);
+
+		double total = 0;
+		bool same = true;
+		for (unsigned f = 0; f < frames + 10; ++f) {
+			// dirty every transform below the subtrees
+			for (auto g : groups)
+				g->setRotation(f * 0.1f);
+
+			auto t0 = bench_clock::now();
+			root->visit(renderer, Mat4::IDENTITY, 0);
+			auto t1 = bench_clock::now();
+			if (f >= 10)
+				total += std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+			auto order = renderer->order();
+			if (serial.empty())
+				serial = order;
+			else if (order != serial)
+				same = false;
+			renderer->clean();
+		}
+
+		double ms = total / frames;
+		if (!threads)
+			base = ms;
+		printf("workers %2u  %7.3f ms/visit  x%.2f  order %s\n", threads, ms, base / ms, same ? "same" : "DIFFERENT");
+	}
+
+	renderer->setWorkerThreads(0);
+	return 0;
+}
@@ -0,0 +1,83 @@
+// Per-sample vs batch conversion of raw SensorData.
+//
+// usage: sensor_convert_bench [samples] [burst]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "band.h"
+#include "SensorConvert.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static volatile float sink;
+
+static std::vector<SensorData> synth_samples(size_t n)
+{
+	std::mt19937 rng(1);
+	std::normal_distribution<float> noise(0, 40);
+	std::vector<SensorData> v(n);
+
+	for (size_t i = 0; i < n; ++i) {
+		float ph = i * 0.01f;
+		auto& d = v[i];
+		d.timestamp = i * 2500;
+		d.v.ax = MAG_1G * std::sin(ph) + noise(rng);
+		d.v.ay = noise(rng);
+		d.v.az = MAG_1G * std::cos(ph) + noise(rng);
+		d.v.gx = ROT_360 * 0.1f * std::cos(ph) + noise(rng);
+		d.v.gy = noise(rng);
+		d.v.gz = noise(rng);
+	}
+	return v;
+}
+
+template <typename F>
+static double run_ns_per_sample(size_t n, F&& f)
+{
+	auto t0 = bench_clock::now();
+	f();
+	auto t1 = bench_clock::now();
+	return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+}
+
+int main(int argc, char **argv)
+{
+	size_t n = argc > 1 ? strtoul(argv[1], nullptr, 0) : 4000000;
+	size_t burst = argc > 2 ? strtoul(argv[2], nullptr, 0) : SensorBatch::MAX;
+	if (!burst || burst > SensorBatch::MAX)
+		burst = SensorBatch::MAX;
+
+	auto samples = synth_samples(n);
+
+	double scalar = run_ns_per_sample(n, [&] {
+		float out[SampleHistory::CHANNELS];
+		float acc = 0;
+		for (auto& d : samples) {
+			convert_sample_exact(d, out);
+			acc += out[SampleHistory::PITCH] + out[SampleHistory::MAG];
+		}
+		sink = acc;
+	});
+
+	SensorBatch batch;
+	double batched = run_ns_per_sample(n, [&] {
+		float acc = 0;
+		for (size_t i = 0; i < n; i += batch.n) {
+			convert_samples(&samples[i], std::min(burst, n - i), batch);
+			acc += batch.ch[SampleHistory::PITCH][0] + batch.ch[SampleHistory::MAG][0];
+		}
+		sink = acc;
+	});
+
+	printf("samples %zu  burst %zu\n", n, burst);
+	printf("per-sample  %7.2f ns/sample\n", scalar);
+	printf("batch       %7.2f ns/sample  (x%.1f)\n", batched, scalar / batched);
+
+	return 0;
+}
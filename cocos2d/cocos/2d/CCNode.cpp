@@ -44,6 +44,8 @@ THE SOFTWARE.
 #include "renderer/CCGLProgram.h"
 #include "renderer/CCGLProgramState.h"
 #include "renderer/CCMaterial.h"
+#include "renderer/CCRenderWorkers.h"
+#include "renderer/CCRenderer.h"
 #include "math/TransformUtils.h"
 
 
@@ -100,6 +102,7 @@ Node::Node()
 , _visible(true)
 , _ignoreAnchorPointForPosition(false)
 , _reorderChildDirty(false)
+, _visitChildrenInParallel(false)
 , _isTransitionFinished(false)
 #if CC_ENABLE_SCRIPT_BINDING
 , _updateScriptHandler(0)
@@ -1208,6 +1211,36 @@ void Node::visit()
     visit(renderer, parentTransform, FLAGS_TRANSFORM_DIRTY);
 }
 
+// Records each child's subtree, and this node's own draw, into a list of
+// its own on the render workers, then queues the lists in visit() order.
+void Node::visitChildrenInParallel(Renderer* renderer, uint32_t flags, bool visibleByCamera)
+{
+    size_t count = _children.size();
+    size_t self = 0;
+    while (self < count && _children.at(self)->_localZOrder < 0)
+        ++self;
+
+    _visitedCommands.resize(count + 1);
+    renderer->getWorkers()->parallelFor(count + 1, [=] (size_t i) {
+        auto& commands = _visitedCommands[i];
+        commands.clear();
+        CommandRecorder recorder(commands);
+        if (i == self)
+        {
+            if (visibleByCamera)
+                this->draw(renderer, _modelViewTransform, flags);
+        }
+        else
+        {
+            _children.at(i < self ? i : i - 1)->visit(renderer, _modelViewTransform, flags);
+        }
+    });
+
+    for (const auto& commands : _visitedCommands)
+        for (auto command : commands)
+            renderer->addCommand(command);
+}
+
 uint32_t Node::processParentFlags(const Mat4& parentTransform, uint32_t parentFlags)
 {
     if(_usingNormalizedPosition)
@@ -1269,7 +1302,12 @@ void Node::visit(Renderer* renderer, const Mat4 &parentTransform, uint32_t paren
 
     int i = 0;
 
-    if(!_children.empty())
+    if (_visitChildrenInParallel && renderer->getWorkers() && _children.size() > 1)
+    {
+        sortAllChildren();
+        visitChildrenInParallel(renderer, flags, visibleByCamera);
+    }
+    else if(!_children.empty())
     {
         sortAllChildren();
         // draw children zOrder < 0
@@ -57,6 +57,7 @@ class ComponentContainer;
 class EventDispatcher;
 class Scene;
 class Renderer;
+class RenderCommand;
 class Director;
 class GLProgram;
 class GLProgramState;
@@ -1180,6 +1181,19 @@ public:
     virtual void visit(Renderer *renderer, const Mat4& parentTransform, uint32_t parentFlags);
     virtual void visit() final;
 
+    /**
+     * Lets visit() traverse the children on the render workers, each child's subtree on one
+     * thread, see Renderer::setWorkerThreads(). Their commands are queued in the order a
+     * serial visit would queue them. The subtrees must not touch shared state while they are
+     * visited: no GL calls, object creation, autorelease, projection or texture matrix
+     * changes, as done by labels or render textures updating their content.
+     * Only Node::visit() does this, subclasses overriding it visit serially.
+     *
+     * @param parallel Whether the children are independent subtrees.
+     */
+    void setVisitChildrenInParallel(bool parallel) { _visitChildrenInParallel = parallel; }
+    bool isVisitChildrenInParallel() const { return _visitChildrenInParallel; }
+
 
     /** Returns the Scene that contains the Node.
      It returns `nullptr` if the node doesn't belong to any Scene.
@@ -1879,6 +1893,7 @@ protected:
 
     Mat4 transform(const Mat4 &parentTransform);
     uint32_t processParentFlags(const Mat4& parentTransform, uint32_t parentFlags);
+    void visitChildrenInParallel(Renderer* renderer, uint32_t flags, bool visibleByCamera);
 
     virtual void updateCascadeOpacity();
     virtual void disableCascadeOpacity();
@@ -1990,6 +2005,8 @@ protected:
                                           ///< Used by Layer and Scene.
 
     bool _reorderChildDirty;          ///< children order dirty flag
+    bool _visitChildrenInParallel;    ///< children are visited on the render workers
+    std::vector<std::vector<RenderCommand*>> _visitedCommands; ///< per child, reused by parallel visits
     bool _isTransitionFinished;       ///< flag to indicate whether the transition was finished
 
 #if CC_ENABLE_SCRIPT_BINDING
@@ -177,6 +177,8 @@ renderer/CCQuadCommand.cpp \
 renderer/CCRenderCommand.cpp \
 renderer/CCRenderState.cpp \
 renderer/CCRenderer.cpp \
+renderer/CCRenderWorkers.cpp \
+renderer/CCStreamBuffer.cpp \
 renderer/CCTechnique.cpp \
 renderer/CCTexture2D.cpp \
 renderer/CCTextureAtlas.cpp \
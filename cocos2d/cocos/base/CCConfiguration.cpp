@@ -51,6 +51,9 @@ Configuration::Configuration()
 , _supportsDiscardFramebuffer(false)
 , _supportsShareableVAO(false)
 , _supportsOESMapBuffer(false)
+, _supportsMapBufferRange(false)
+, _supportsBufferStorage(false)
+, _supportsInstancing(false)
 , _supportsOESDepth24(false)
 , _supportsOESPackedDepthStencil(false)
 , _maxSamplesAllowed(0)
@@ -161,6 +164,21 @@ void Configuration::gatherGPUInfo()
     _supportsOESMapBuffer = checkForGLExtension("GL_OES_mapbuffer");
     _valueDict["gl.supports_OES_map_buffer"] = Value(_supportsOESMapBuffer);
 
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32 || CC_TARGET_PLATFORM == CC_PLATFORM_LINUX)
+    _supportsMapBufferRange = checkForGLExtension("GL_ARB_map_buffer_range") && checkForGLExtension("GL_ARB_sync");
+#ifdef GL_ARB_buffer_storage
+    // the GLEW bundled for Windows predates it
+    _supportsBufferStorage = _supportsMapBufferRange && checkForGLExtension("GL_ARB_buffer_storage");
+#endif
+#endif
+    _valueDict["gl.supports_map_buffer_range"] = Value(_supportsMapBufferRange);
+    _valueDict["gl.supports_buffer_storage"] = Value(_supportsBufferStorage);
+
+#if CC_USE_INSTANCING
+    _supportsInstancing = checkForGLExtension("GL_ARB_instanced_arrays") && checkForGLExtension("GL_ARB_draw_instanced");
+#endif
+    _valueDict["gl.supports_instancing"] = Value(_supportsInstancing);
+
     _supportsOESDepth24 = checkForGLExtension("GL_OES_depth24");
     _valueDict["gl.supports_OES_depth24"] = Value(_supportsOESDepth24);
 
@@ -295,6 +313,21 @@ bool Configuration::supportsMapBuffer() const
 #endif
 }
 
+bool Configuration::supportsMapBufferRange() const
+{
+    return _supportsMapBufferRange;
+}
+
+bool Configuration::supportsBufferStorage() const
+{
+    return _supportsBufferStorage;
+}
+
+bool Configuration::supportsInstancing() const
+{
+    return _supportsInstancing;
+}
+
 bool Configuration::supportsOESDepth24() const
 {
     return _supportsOESDepth24;
@@ -171,6 +171,31 @@ public:
      */
     bool supportsMapBuffer() const;
 
+    /** Whether or not glMapBufferRange() and fence syncs are supported, to stream into
+     * parts of a buffer the GPU is not reading.
+     *
+     * Only checked where GLEW loads the GL 3 entry points, `false` elsewhere.
+     *
+     * @return Whether or not `glMapBufferRange()` and `glFenceSync()` are supported.
+     */
+    bool supportsMapBufferRange() const;
+
+    /** Whether or not glBufferStorage() is supported, to keep a buffer mapped while the GPU reads it.
+     *
+     * `false` when the GL headers don't declare GL_ARB_buffer_storage.
+     *
+     * @return Whether or not persistently mapped buffers are supported.
+     */
+    bool supportsBufferStorage() const;
+
+    /** Whether or not instanced arrays are supported, to draw quads as instances.
+     *
+     * Only checked when CC_USE_INSTANCING is enabled, `false` elsewhere.
+     *
+     * @return Whether or not `glVertexAttribDivisorARB()` and `glDrawArraysInstancedARB()` are supported.
+     */
+    bool supportsInstancing() const;
+
     
     /** Max support directional light in shader, for Sprite3D.
      *
@@ -268,6 +293,9 @@ protected:
     bool            _supportsDiscardFramebuffer;
     bool            _supportsShareableVAO;
     bool            _supportsOESMapBuffer;
+    bool            _supportsMapBufferRange;
+    bool            _supportsBufferStorage;
+    bool            _supportsInstancing;
     bool            _supportsOESDepth24;
     bool            _supportsOESPackedDepthStencil;
     
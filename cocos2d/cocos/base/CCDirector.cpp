@@ -167,6 +167,7 @@ Director::~Director()
     CC_SAFE_RELEASE(_FPSLabel);
     CC_SAFE_RELEASE(_drawnVerticesLabel);
     CC_SAFE_RELEASE(_drawnBatchesLabel);
+    CC_SAFE_RELEASE(_reorderedBatchesLabel);
 
     CC_SAFE_RELEASE(_runningScene);
     CC_SAFE_RELEASE(_notificationNode);
@@ -469,6 +470,27 @@ void Director::resetMatrixStack()
     initMatrixStack();
 }
 
+// threads visiting nodes in parallel don't share the model view stack
+static thread_local std::stack<Mat4>* s_threadModelViewMatrixStack = nullptr;
+
+void Director::useThreadModelViewMatrixStack()
+{
+    static thread_local std::stack<Mat4> stack;
+    if (stack.empty())
+        stack.push(Mat4::IDENTITY);
+    s_threadModelViewMatrixStack = &stack;
+}
+
+std::stack<Mat4>& Director::modelViewMatrixStack()
+{
+    return s_threadModelViewMatrixStack ? *s_threadModelViewMatrixStack : _modelViewMatrixStack;
+}
+
+const std::stack<Mat4>& Director::modelViewMatrixStack() const
+{
+    return s_threadModelViewMatrixStack ? *s_threadModelViewMatrixStack : _modelViewMatrixStack;
+}
+
 void Director::initProjectionMatrixStack(size_t stackCount)
 {
     _projectionMatrixStackList.clear();
@@ -487,7 +509,7 @@ void Director::popMatrix(MATRIX_STACK_TYPE type)
 {
     if(MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW == type)
     {
-        _modelViewMatrixStack.pop();
+        modelViewMatrixStack().pop();
     }
     else if(MATRIX_STACK_TYPE::MATRIX_STACK_PROJECTION == type)
     {
@@ -512,7 +534,7 @@ void Director::loadIdentityMatrix(MATRIX_STACK_TYPE type)
 {
     if(MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW == type)
     {
-        _modelViewMatrixStack.top() = Mat4::IDENTITY;
+        modelViewMatrixStack().top() = Mat4::IDENTITY;
     }
     else if(MATRIX_STACK_TYPE::MATRIX_STACK_PROJECTION == type)
     {
@@ -537,7 +559,7 @@ void Director::loadMatrix(MATRIX_STACK_TYPE type, const Mat4& mat)
 {
     if(MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW == type)
     {
-        _modelViewMatrixStack.top() = mat;
+        modelViewMatrixStack().top() = mat;
     }
     else if(MATRIX_STACK_TYPE::MATRIX_STACK_PROJECTION == type)
     {
@@ -562,7 +584,7 @@ void Director::multiplyMatrix(MATRIX_STACK_TYPE type, const Mat4& mat)
 {
     if(MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW == type)
     {
-        _modelViewMatrixStack.top() *= mat;
+        modelViewMatrixStack().top() *= mat;
     }
     else if(MATRIX_STACK_TYPE::MATRIX_STACK_PROJECTION == type)
     {
@@ -587,7 +609,8 @@ void Director::pushMatrix(MATRIX_STACK_TYPE type)
 {
     if(type == MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW)
     {
-        _modelViewMatrixStack.push(_modelViewMatrixStack.top());
+        auto& stack = modelViewMatrixStack();
+        stack.push(stack.top());
     }
     else if(type == MATRIX_STACK_TYPE::MATRIX_STACK_PROJECTION)
     {
@@ -612,7 +635,7 @@ const Mat4& Director::getMatrix(MATRIX_STACK_TYPE type) const
 {
     if(type == MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW)
     {
-        return _modelViewMatrixStack.top();
+        return modelViewMatrixStack().top();
     }
     else if(type == MATRIX_STACK_TYPE::MATRIX_STACK_PROJECTION)
     {
@@ -624,7 +647,7 @@ const Mat4& Director::getMatrix(MATRIX_STACK_TYPE type) const
     }
 
     CCASSERT(false, "unknown matrix stack type, will return modelview matrix instead");
-    return  _modelViewMatrixStack.top();
+    return  modelViewMatrixStack().top();
 }
 
 const Mat4& Director::getProjectionMatrix(size_t index) const
@@ -1077,6 +1100,7 @@ void Director::reset()
     CC_SAFE_RELEASE_NULL(_FPSLabel);
     CC_SAFE_RELEASE_NULL(_drawnBatchesLabel);
     CC_SAFE_RELEASE_NULL(_drawnVerticesLabel);
+    CC_SAFE_RELEASE_NULL(_reorderedBatchesLabel);
     
     // purge bitmap cache
     FontFNT::purgeCachedData();
@@ -1258,6 +1282,8 @@ void Director::showStats()
 
     static unsigned long prevCalls = 0;
     static unsigned long prevVerts = 0;
+    static unsigned long prevBefore = 0;
+    static unsigned long prevAfter = 0;
 
     ++_frames;
     _accumDt += _deltaTime;
@@ -1292,6 +1318,19 @@ void Director::showStats()
         }
 
         const Mat4& identity = Mat4::IDENTITY;
+        // batches the render queues had before and after reordering them, when they do
+        if (_renderer->isBatchReordering() && _reorderedBatchesLabel)
+        {
+            auto before = (unsigned long)_renderer->getBatchesBeforeReorder();
+            auto after = (unsigned long)_renderer->getBatchesAfterReorder();
+            if( before != prevBefore || after != prevAfter ) {
+                sprintf(buffer, "GL sort:%6lu>%6lu", before, after);
+                _reorderedBatchesLabel->setString(buffer);
+                prevBefore = before;
+                prevAfter = after;
+            }
+            _reorderedBatchesLabel->visit(_renderer, identity, 0);
+        }
         _drawnVerticesLabel->visit(_renderer, identity, 0);
         _drawnBatchesLabel->visit(_renderer, identity, 0);
         _FPSLabel->visit(_renderer, identity, 0);
@@ -1321,15 +1360,18 @@ void Director::createStatsLabel()
     std::string fpsString = "00.0";
     std::string drawBatchString = "000";
     std::string drawVerticesString = "00000";
+    std::string reorderedBatchesString = "000";
     if (_FPSLabel)
     {
         fpsString = _FPSLabel->getString();
         drawBatchString = _drawnBatchesLabel->getString();
         drawVerticesString = _drawnVerticesLabel->getString();
+        reorderedBatchesString = _reorderedBatchesLabel->getString();
         
         CC_SAFE_RELEASE_NULL(_FPSLabel);
         CC_SAFE_RELEASE_NULL(_drawnBatchesLabel);
         CC_SAFE_RELEASE_NULL(_drawnVerticesLabel);
+        CC_SAFE_RELEASE_NULL(_reorderedBatchesLabel);
         _textureCache->removeTextureForKey("/cc_fps_images");
         FileUtils::getInstance()->purgeCachedEntries();
     }
@@ -1379,10 +1421,16 @@ void Director::createStatsLabel()
     _drawnVerticesLabel->initWithString(drawVerticesString, texture, 12, 32, '.');
     _drawnVerticesLabel->setScale(scaleFactor);
 
+    _reorderedBatchesLabel = LabelAtlas::create();
+    _reorderedBatchesLabel->retain();
+    _reorderedBatchesLabel->setIgnoreContentScaleFactor(true);
+    _reorderedBatchesLabel->initWithString(reorderedBatchesString, texture, 12, 32, '.');
+    _reorderedBatchesLabel->setScale(scaleFactor);
 
     Texture2D::setDefaultAlphaPixelFormat(currentFormat);
 
     const int height_spacing = 22 / CC_CONTENT_SCALE_FACTOR();
+    _reorderedBatchesLabel->setPosition(Vec2(0, height_spacing*3) + CC_DIRECTOR_STATS_POSITION);
     _drawnVerticesLabel->setPosition(Vec2(0, height_spacing*2) + CC_DIRECTOR_STATS_POSITION);
     _drawnBatchesLabel->setPosition(Vec2(0, height_spacing*1) + CC_DIRECTOR_STATS_POSITION);
     _FPSLabel->setPosition(Vec2(0, height_spacing*0)+CC_DIRECTOR_STATS_POSITION);
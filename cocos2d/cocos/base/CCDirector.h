@@ -564,6 +564,14 @@ public:
      */
     void resetMatrixStack();
 
+    /**
+     * Gives the calling thread a model view matrix stack of its own, for the
+     * render workers visiting nodes in parallel. Projection and texture
+     * stacks stay shared and must not be changed by those nodes.
+     * @js NA
+     */
+    static void useThreadModelViewMatrixStack();
+
     /**
      * Init the projection matrix stack.
      * @param stackCount The size of projection matrix stack.
@@ -616,6 +624,10 @@ protected:
 
     void initMatrixStack();
 
+    // the calling thread's model view stack
+    std::stack<Mat4>& modelViewMatrixStack();
+    const std::stack<Mat4>& modelViewMatrixStack() const;
+
     std::stack<Mat4> _modelViewMatrixStack;
     /** In order to support GL MultiView features, we need to use the matrix array,
         but we don't know the number of MultiView, so using the vector instead.
@@ -668,6 +680,7 @@ protected:
     LabelAtlas *_FPSLabel = nullptr;
     LabelAtlas *_drawnBatchesLabel = nullptr;
     LabelAtlas *_drawnVerticesLabel = nullptr;
+    LabelAtlas *_reorderedBatchesLabel = nullptr;
     
     /** Whether or not the Director is paused */
     bool _paused = false;
@@ -165,6 +165,20 @@ THE SOFTWARE.
 #define CC_TEXTURE_ATLAS_USE_VAO 1
 #endif
 
+/** @def CC_USE_INSTANCING
+ * If enabled, the Renderer draws the quads of SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP as instances
+ * where the GPU supports GL_ARB_instanced_arrays, instead of transforming their vertices on the CPU.
+ * Only available where GLEW loads the entry points, Windows and Linux.
+ * To disable it set it to 0. Enabled by default.
+ */
+#ifndef CC_USE_INSTANCING
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32 || CC_TARGET_PLATFORM == CC_PLATFORM_LINUX)
+#define CC_USE_INSTANCING 1
+#else
+#define CC_USE_INSTANCING 0
+#endif
+#endif
+
 
 /** @def CC_USE_LA88_LABELS
  * If enabled, it will use LA88 (Luminance Alpha 16-bit textures) for LabelTTF objects.
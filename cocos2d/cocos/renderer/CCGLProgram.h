@@ -186,6 +186,8 @@ public:
     static const char* SHADER_NAME_POSITION_TEXTURE_COLOR;
     /**Built in shader for 2d. Support Position, Texture and Color vertex attribute, but without multiply vertex by MVP matrix.*/
     static const char* SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP;
+    /**Built in shader drawing the quads of SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP as instances, see Renderer::setInstancing().*/
+    static const char* SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED;
     /**Built in shader for 2d. Support Position, Texture vertex attribute, but include alpha test.*/
     static const char* SHADER_NAME_POSITION_TEXTURE_ALPHA_TEST;
     /**Built in shader for 2d. Support Position, Texture and Color vertex attribute, include alpha test and without multiply vertex by MVP matrix.*/
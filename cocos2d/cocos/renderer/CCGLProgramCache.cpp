@@ -42,6 +42,7 @@ NS_CC_BEGIN
 enum {
     kShaderType_PositionTextureColor,
     kShaderType_PositionTextureColor_noMVP,
+    kShaderType_PositionTextureColor_instanced,
     kShaderType_PositionTextureColorAlphaTest,
     kShaderType_PositionTextureColorAlphaTestNoMV,
     kShaderType_PositionColor,
@@ -156,6 +157,10 @@ void GLProgramCache::loadDefaultGLPrograms()
     loadDefaultGLProgram(p, kShaderType_PositionTextureColor_noMVP);
     _programs.emplace(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP, p);
 
+    p = new (std::nothrow) GLProgram();
+    loadDefaultGLProgram(p, kShaderType_PositionTextureColor_instanced);
+    _programs.emplace(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED, p);
+
     // Position Texture Color alpha test
     p = new (std::nothrow) GLProgram();
     loadDefaultGLProgram(p, kShaderType_PositionTextureColorAlphaTest);
@@ -328,6 +333,10 @@ void GLProgramCache::reloadDefaultGLPrograms()
     p->reset();
     loadDefaultGLProgram(p, kShaderType_PositionTextureColor_noMVP);
 
+    p = getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED);
+    p->reset();
+    loadDefaultGLProgram(p, kShaderType_PositionTextureColor_instanced);
+
     // Position Texture Color alpha test
     p = getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_ALPHA_TEST);
     p->reset();
@@ -517,6 +526,9 @@ void GLProgramCache::loadDefaultGLProgram(GLProgram *p, int type)
         case kShaderType_PositionTextureColor_noMVP:
             p->initWithByteArrays(ccPositionTextureColor_noMVP_vert, ccPositionTextureColor_noMVP_frag);
             break;
+        case kShaderType_PositionTextureColor_instanced:
+            p->initWithByteArrays(ccPositionTextureColor_instanced_vert, ccPositionTextureColor_noMVP_frag);
+            break;
         case kShaderType_PositionTextureColorAlphaTest:
             p->initWithByteArrays(ccPositionTextureColor_vert, ccPositionTextureColorAlphaTest_frag);
             break;
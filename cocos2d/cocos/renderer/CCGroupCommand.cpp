@@ -49,6 +49,8 @@ bool GroupCommandManager::init()
 
 int GroupCommandManager::getGroupID()
 {
+    std::lock_guard<std::mutex> lock(_mutex);
+
     //Reuse old id
     if (!_unusedIDs.empty())
     {
@@ -68,6 +70,7 @@ int GroupCommandManager::getGroupID()
 
 void GroupCommandManager::releaseGroupID(int groupID)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
     _groupMapping[groupID] = false;
     _unusedIDs.push_back(groupID);
 }
@@ -27,6 +27,7 @@
 #ifndef _CC_GROUPCOMMAND_H_
 #define _CC_GROUPCOMMAND_H_
 
+#include <mutex>
 #include <vector>
 #include <unordered_map>
 
@@ -54,6 +55,8 @@ protected:
     bool init();
     std::unordered_map<int, bool> _groupMapping;
     std::vector<int> _unusedIDs;
+    // render workers may init group commands
+    std::mutex _mutex;
 };
 
 /**
@@ -68,6 +68,9 @@ void QuadCommand::init(float globalOrder, GLuint textureID, GLProgramState* glPr
     triangles.indices = __indices;
     triangles.indexCount = (int)quadCount * 6;
     TrianglesCommand::init(globalOrder, textureID, glProgramState, blendType, triangles, mv, flags);
+    // a single quad was checked by TrianglesCommand::init() already
+    if (quadCount != 1)
+        checkQuads(quadCount);
 }
 
 void QuadCommand::reIndex(int indicesCount)
@@ -0,0 +1,206 @@
+/****************************************************************************
+ Copyright (c) 2017-2018 Xiamen Yaji Software Co., Ltd.
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "renderer/CCRenderWorkers.h"
+#include "renderer/CCRenderer.h"
+#include "base/CCDirector.h"
+
+NS_CC_BEGIN
+
+namespace {
+
+thread_local RenderWorkers* s_workers = nullptr;    // pool the calling thread belongs to
+thread_local unsigned s_workerIndex = 0;
+thread_local CommandRecorder* s_recorder = nullptr;
+
+const unsigned SPIN_ROUNDS = 64;    // yields before a worker goes to sleep
+
+}
+
+RenderWorkers::RenderWorkers(unsigned threads)
+: _queued(0)
+, _stopping(false)
+{
+    for (unsigned i = 0; i <= threads; ++i)
+        _deques.push_back(std::unique_ptr<Deque>(new Deque));
+    for (unsigned i = 1; i <= threads; ++i)
+        _threads.emplace_back(&RenderWorkers::loop, this, i);
+}
+
+RenderWorkers::~RenderWorkers()
+{
+    {
+        std::unique_lock<std::mutex> lock(_sleepLock);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto& t : _threads)
+        t.join();
+}
+
+// threads outside the pool are taken for the cocos thread
+unsigned RenderWorkers::self()
+{
+    return s_workers == this ? s_workerIndex : 0;
+}
+
+void RenderWorkers::run(Job& job, size_t count)
+{
+    if (!count)
+        return;
+
+    job.pending.store(count, std::memory_order_relaxed);
+    unsigned index = self();
+    Deque& d = *_deques[index];
+    {
+        std::unique_lock<std::mutex> lock(d.lock);
+        if (d.count + count > d.ring.size())
+        {
+            size_t size = d.ring.empty() ? 64 : d.ring.size();
+            while (size < d.count + count)
+                size *= 2;
+            std::vector<Task> bigger(size);
+            for (size_t i = 0; i < d.count; ++i)
+                bigger[i] = d.ring[(d.head + i) & (d.ring.size() - 1)];
+            d.ring.swap(bigger);
+            d.head = 0;
+        }
+        // the last one first, so that this thread pops them in order
+        size_t mask = d.ring.size() - 1;
+        for (size_t i = count; i--; )
+            d.ring[(d.head + d.count++) & mask] = Task{&job, i};
+    }
+
+    _queued.fetch_add(count);
+    if (!_threads.empty())
+    {
+        // pairs with the check in loop(), made with the lock held
+        std::unique_lock<std::mutex> lock(_sleepLock);
+    }
+    _wake.notify_all();
+
+    while (job.pending.load(std::memory_order_acquire))
+    {
+        Task task;
+        if (pop(index, task) || steal(index, task))
+            execute(task);
+        else
+            std::this_thread::yield();
+    }
+}
+
+bool RenderWorkers::pop(unsigned index, Task& task)
+{
+    Deque& d = *_deques[index];
+    std::unique_lock<std::mutex> lock(d.lock);
+    if (!d.count)
+        return false;
+    task = d.ring[(d.head + --d.count) & (d.ring.size() - 1)];
+    _queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool RenderWorkers::steal(unsigned index, Task& task)
+{
+    size_t n = _deques.size();
+    for (size_t i = 1; i < n; ++i)
+    {
+        Deque& d = *_deques[(index + i) % n];
+        std::unique_lock<std::mutex> lock(d.lock);
+        if (!d.count)
+            continue;
+        task = d.ring[d.head];
+        d.head = (d.head + 1) & (d.ring.size() - 1);
+        --d.count;
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void RenderWorkers::execute(const Task& task)
+{
+    Job* job = task.job;
+    job->call(job->func, task.index);
+    // the job lives on the stack of the thread waiting for it
+    job->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void RenderWorkers::loop(unsigned index)
+{
+    s_workers = this;
+    s_workerIndex = index;
+    Director::useThreadModelViewMatrixStack();
+
+    unsigned idle = 0;
+    for (;;)
+    {
+        Task task;
+        if (pop(index, task) || steal(index, task))
+        {
+            execute(task);
+            idle = 0;
+            continue;
+        }
+        if (++idle < SPIN_ROUNDS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepLock);
+        _wake.wait(lock, [this] { return _stopping || _queued.load() > 0; });
+        if (_stopping)
+            break;
+        idle = 0;
+    }
+}
+
+CommandRecorder::CommandRecorder(std::vector<RenderCommand*>& commands)
+: _commands(commands)
+, _previous(s_recorder)
+{
+    s_recorder = this;
+}
+
+CommandRecorder::~CommandRecorder()
+{
+    s_recorder = _previous;
+}
+
+CommandRecorder* CommandRecorder::current()
+{
+    return s_recorder;
+}
+
+void CommandRecorder::add(RenderCommand* command)
+{
+    if (_groups.empty())
+        _commands.push_back(command);
+    else
+        _groups.back()->push_back(command);
+}
+
+NS_CC_END
@@ -0,0 +1,146 @@
+/****************************************************************************
+ Copyright (c) 2017-2018 Xiamen Yaji Software Co., Ltd.
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef __CC_RENDER_WORKERS_H_
+#define __CC_RENDER_WORKERS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "platform/CCPlatformMacros.h"
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+NS_CC_BEGIN
+
+class RenderCommand;
+class RenderQueue;
+
+/**
+ Work-stealing thread pool helping the cocos thread to build a frame, see
+ Renderer::setWorkerThreads(). Each thread owns a deque of tasks: it pops
+ the newest of its own and steals the oldest of the others. The thread
+ calling parallelFor() runs tasks too until all of its tasks are done, so
+ calls may nest.
+ */
+class CC_DLL RenderWorkers
+{
+public:
+    /** Starts `threads` threads besides the calling one. */
+    explicit RenderWorkers(unsigned threads);
+    ~RenderWorkers();
+
+    RenderWorkers(const RenderWorkers&) = delete;
+    RenderWorkers& operator=(const RenderWorkers&) = delete;
+
+    /** Number of threads besides the cocos thread. */
+    unsigned getThreadCount() const { return (unsigned)_threads.size(); }
+
+    /** Calls func(i) for every i in [0, count), on any thread; returns when all calls did. */
+    template <typename F>
+    void parallelFor(size_t count, const F& func)
+    {
+        Job job;
+        job.call = [] (const void* f, size_t i) { (*static_cast<const F*>(f))(i); };
+        job.func = &func;
+        run(job, count);
+    }
+
+private:
+    struct Job
+    {
+        void (*call)(const void* func, size_t index);
+        const void* func;
+        std::atomic<size_t> pending;
+    };
+
+    struct Task
+    {
+        Job* job;
+        size_t index;
+    };
+
+    // ring of tasks, power-of-two size; the owner works at the back, thieves at the front
+    struct Deque
+    {
+        std::mutex lock;
+        std::vector<Task> ring;
+        size_t head = 0, count = 0;
+    };
+
+    void run(Job& job, size_t count);
+    void loop(unsigned index);
+    unsigned self();
+    bool pop(unsigned index, Task& task);
+    bool steal(unsigned index, Task& task);
+    static void execute(const Task& task);
+
+    std::vector<std::unique_ptr<Deque>> _deques;    // [0] belongs to the cocos thread
+    std::vector<std::thread> _threads;
+
+    std::atomic<size_t> _queued;
+    std::mutex _sleepLock;
+    std::condition_variable _wake;
+    bool _stopping;
+};
+
+/**
+ Collects the commands the calling thread adds to the renderer while it
+ exists, instead of queuing them. Groups pushed meanwhile still receive
+ their commands directly. Used to visit subtrees on the render workers;
+ the caller appends the list to the renderer in the order it wants.
+ */
+class CC_DLL CommandRecorder
+{
+public:
+    explicit CommandRecorder(std::vector<RenderCommand*>& commands);
+    ~CommandRecorder();
+
+    /** The recorder of the calling thread, nullptr if it doesn't record. */
+    static CommandRecorder* current();
+
+    void add(RenderCommand* command);
+    void pushGroup(RenderQueue* queue) { _groups.push_back(queue); }
+    void popGroup() { _groups.pop_back(); }
+
+private:
+    std::vector<RenderCommand*>& _commands;
+    std::vector<RenderQueue*> _groups;
+    CommandRecorder* _previous;
+};
+
+NS_CC_END
+
+/**
+ end of support group
+ @}
+ */
+#endif //__CC_RENDER_WORKERS_H_
@@ -27,6 +27,12 @@
 
 #include <algorithm>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include "renderer/CCTrianglesCommand.h"
 #include "renderer/CCBatchCommand.h"
 #include "renderer/CCCustomCommand.h"
@@ -38,6 +44,8 @@
 #include "renderer/CCTechnique.h"
 #include "renderer/CCPass.h"
 #include "renderer/CCRenderState.h"
+#include "renderer/CCRenderWorkers.h"
+#include "renderer/CCStreamBuffer.h"
 #include "renderer/ccGLStateCache.h"
 
 #include "base/CCConfiguration.h"
@@ -61,8 +69,15 @@ static bool compare3DCommand(RenderCommand* a, RenderCommand* b)
     return  a->getDepth() > b->getDepth();
 }
 
+// how many commands reordering looks ahead for one to batch with the previous command
+static const int REORDER_WINDOW = 32;
+// commands with more vertices keep their place rather than being bounded
+static const int REORDER_MAX_VERTICES = 256;
+
 // queue
 RenderQueue::RenderQueue()
+: _batchesBeforeReorder(0)
+, _batchesAfterReorder(0)
 {
     
 }
@@ -109,12 +124,123 @@ ssize_t RenderQueue::size() const
     return result;
 }
 
-void RenderQueue::sort()
+void RenderQueue::sort(bool reorderBatches)
 {
     // Don't sort _queue0, it already comes sorted
     std::stable_sort(std::begin(_commands[QUEUE_GROUP::TRANSPARENT_3D]), std::end(_commands[QUEUE_GROUP::TRANSPARENT_3D]), compare3DCommand);
     std::stable_sort(std::begin(_commands[QUEUE_GROUP::GLOBALZ_NEG]), std::end(_commands[QUEUE_GROUP::GLOBALZ_NEG]), compareRenderCommand);
     std::stable_sort(std::begin(_commands[QUEUE_GROUP::GLOBALZ_POS]), std::end(_commands[QUEUE_GROUP::GLOBALZ_POS]), compareRenderCommand);
+
+    _batchesBeforeReorder = _batchesAfterReorder = 0;
+    if (reorderBatches)
+    {
+        // the camera being rendered has loaded its view projection; see Renderer::render() for the queues drawn with it
+        const Mat4& projection = Director::getInstance()->getMatrix(MATRIX_STACK_TYPE::MATRIX_STACK_PROJECTION);
+        this->reorderBatches(_commands[QUEUE_GROUP::GLOBALZ_NEG], projection);
+        this->reorderBatches(_commands[QUEUE_GROUP::GLOBALZ_ZERO], projection);
+        this->reorderBatches(_commands[QUEUE_GROUP::GLOBALZ_POS], projection);
+    }
+}
+
+bool RenderQueue::ReorderItem::overlaps(const ReorderItem& other) const
+{
+    return min.x < other.max.x && other.min.x < max.x && min.y < other.max.y && other.min.y < max.y;
+}
+
+bool RenderQueue::ReorderItem::bound(const TrianglesCommand* command, const Mat4& projection)
+{
+    auto& triangles = command->getTriangles();
+    if (triangles.vertCount <= 0 || triangles.vertCount > REORDER_MAX_VERTICES)
+        return false;
+
+    Mat4 mvp = projection * command->getModelView();
+    min.set(FLT_MAX, FLT_MAX);
+    max.set(-FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < triangles.vertCount; ++i)
+    {
+        auto& v = triangles.verts[i].vertices;
+        Vec4 p;
+        mvp.transformVector(Vec4(v.x, v.y, v.z, 1.0f), &p);
+        if (p.w <= 0)
+            return false;
+
+        Vec2 s(p.x / p.w, p.y / p.w);
+        min.set(std::min(min.x, s.x), std::min(min.y, s.y));
+        max.set(std::max(max.x, s.x), std::max(max.y, s.y));
+    }
+    return true;
+}
+
+ssize_t RenderQueue::countReorderedBatches() const
+{
+    auto& items = _reorderItems;
+    ssize_t batches = 0;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (items[i].triangles && (items[i].key < 0 || i == 0 || items[i - 1].key != items[i].key))
+            ++batches;
+    }
+    return batches;
+}
+
+void RenderQueue::reorderBatches(std::vector<RenderCommand*>& commands, const Mat4& projection)
+{
+    auto& items = _reorderItems;
+    items.resize(commands.size());
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        auto& item = items[i];
+        item.cmd = commands[i];
+        item.key = -1;
+        item.movable = false;
+        item.triangles = item.cmd->getType() == RenderCommand::Type::TRIANGLES_COMMAND;
+        if (!item.triangles)
+            continue;
+
+        // the same conditions as in Renderer::drawBatchedTriangles()
+        auto cmd = static_cast<TrianglesCommand*>(item.cmd);
+        if (!cmd->isSkipBatching())
+            item.key = (int64_t)cmd->getMaterialID() | (int64_t)cmd->isInstanceable() << 32;
+        item.movable = !cmd->is3D() && item.bound(cmd, projection);
+    }
+    _batchesBeforeReorder += countReorderedBatches();
+
+    // whether items[index] overlaps any of items[begin, index)
+    auto overlapsAny = [&items] (size_t begin, size_t index) {
+        for (size_t k = begin; k < index; ++k)
+        {
+            if (items[index].overlaps(items[k]))
+                return true;
+        }
+        return false;
+    };
+
+    // pull the next command of the previous one's material forward over commands it doesn't overlap;
+    // commands that can't move stop the search, so nothing crosses them
+    for (size_t i = 1; i < items.size(); ++i)
+    {
+        const int64_t key = items[i - 1].key;
+        if (key < 0 || items[i].key == key || !items[i].movable)
+            continue;
+
+        // the bounds of all the commands skipped so far, to reject the exact test quickly
+        ReorderItem skipped = items[i];
+        size_t end = std::min(items.size(), i + REORDER_WINDOW);
+        for (size_t j = i + 1; j < end && items[j].movable; ++j)
+        {
+            if (items[j].key == key && (!items[j].overlaps(skipped) || !overlapsAny(i, j)))
+            {
+                std::rotate(items.begin() + i, items.begin() + j, items.begin() + j + 1);
+                break;
+            }
+            skipped.min.set(std::min(skipped.min.x, items[j].min.x), std::min(skipped.min.y, items[j].min.y));
+            skipped.max.set(std::max(skipped.max.x, items[j].max.x), std::max(skipped.max.y, items[j].max.y));
+        }
+    }
+    _batchesAfterReorder += countReorderedBatches();
+
+    for (size_t i = 0; i < commands.size(); ++i)
+        commands[i] = items[i].cmd;
 }
 
 RenderCommand* RenderQueue::operator[](ssize_t index) const
@@ -193,17 +319,113 @@ void RenderQueue::restoreRenderState()
 //
 //
 static const int DEFAULT_RENDER_QUEUE = 0;
+// batches with fewer vertices are filled by the render thread alone
+static const int PARALLEL_FILL_VERTICES = 4096;
+static const size_t FILL_CHUNKS_PER_THREAD = 4;
+// filling an instance transforms three corners
+static const int INSTANCE_FILL_COST = 3;
+
+// what the instanced quad shader reads per quad
+struct QuadInstance
+{
+    Vec3 origin;        // bottom left corner
+    Vec2 axisX;         // bottom edge
+    Vec2 axisY;         // left edge
+    Color4B color;
+    Tex2F uvOrigin;     // texture coords at the bottom left
+    Tex2F uvEnd;        // and at the top right
+};
+static_assert(sizeof(QuadInstance) == 48, "QuadInstance should be 48 bytes");
+
+static void fillInstances(const TrianglesCommand* cmd, QuadInstance* instances)
+{
+    const Mat4& modelView = cmd->getModelView();
+    const V3F_C4B_T2F* v = cmd->getVertices();
+    for (ssize_t i = 0, count = cmd->getQuadCount(); i < count; ++i, v += 4)
+    {
+        // tl, bl, tr, br as in V3F_C4B_T2F_Quad
+        Vec3 tl = v[0].vertices, bl = v[1].vertices, br = v[3].vertices;
+        modelView.transformPoint(&tl);
+        modelView.transformPoint(&bl);
+        modelView.transformPoint(&br);
+
+        auto& instance = instances[i];
+        instance.origin = bl;
+        instance.axisX.set(br.x - bl.x, br.y - bl.y);
+        instance.axisY.set(tl.x - bl.x, tl.y - bl.y);
+        instance.color = v[1].colors;
+        instance.uvOrigin = v[1].texCoords;
+        instance.uvEnd = v[2].texCoords;
+    }
+}
+
+// copies the vertices of a TrianglesCommand, converted to world coordinates
+static void transformVertices(const Mat4& modelView, const V3F_C4B_T2F* src, V3F_C4B_T2F* dst, ssize_t count)
+{
+#if defined(__SSE__)
+    const __m128 col0 = _mm_loadu_ps(&modelView.m[0]);
+    const __m128 col1 = _mm_loadu_ps(&modelView.m[4]);
+    const __m128 col2 = _mm_loadu_ps(&modelView.m[8]);
+    const __m128 col3 = _mm_loadu_ps(&modelView.m[12]);
+    for (ssize_t i = 0; i < count; ++i)
+    {
+        V3F_C4B_T2F v = src[i];
+        __m128 p = _mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(v.vertices.x)), _mm_mul_ps(col1, _mm_set1_ps(v.vertices.y)));
+        p = _mm_add_ps(_mm_add_ps(p, _mm_mul_ps(col2, _mm_set1_ps(v.vertices.z))), col3);
+        float out[4];
+        _mm_storeu_ps(out, p);
+        v.vertices.set(out[0], out[1], out[2]);
+        dst[i] = v;
+    }
+#elif defined(__ARM_NEON__) || defined(__aarch64__)
+    const float32x4_t col0 = vld1q_f32(&modelView.m[0]);
+    const float32x4_t col1 = vld1q_f32(&modelView.m[4]);
+    const float32x4_t col2 = vld1q_f32(&modelView.m[8]);
+    const float32x4_t col3 = vld1q_f32(&modelView.m[12]);
+    for (ssize_t i = 0; i < count; ++i)
+    {
+        V3F_C4B_T2F v = src[i];
+        float32x4_t p = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(col3, col0, v.vertices.x), col1, v.vertices.y), col2, v.vertices.z);
+        float out[4];
+        vst1q_f32(out, p);
+        v.vertices.set(out[0], out[1], out[2]);
+        dst[i] = v;
+    }
+#else
+    for (ssize_t i = 0; i < count; ++i)
+    {
+        V3F_C4B_T2F v = src[i];
+        modelView.transformPoint(&v.vertices);
+        dst[i] = v;
+    }
+#endif
+}
 
 //
 // constructors, destructor, init
 //
 Renderer::Renderer()
-:_lastBatchedMeshCommand(nullptr)
+:_workers(nullptr)
+,_lastBatchedMeshCommand(nullptr)
+,_buffersVAO(0)
+,_vertexStream(nullptr)
+,_indexStream(nullptr)
+,_instanceVAO(0)
+,_cornerVBO(0)
+,_instanceStream(nullptr)
+,_instanceProgram(nullptr)
+,_instancing(true)
+,_batchReordering(false)
 ,_triBatchesToDrawCapacity(-1)
 ,_triBatchesToDraw(nullptr)
 ,_filledVertex(0)
 ,_filledIndex(0)
+,_filledInstance(0)
 ,_glViewAssigned(false)
+,_drawnBatches(0)
+,_drawnVertices(0)
+,_batchesBeforeReorder(0)
+,_batchesAfterReorder(0)
 ,_isRendering(false)
 ,_isDepthTestFor2D(false)
 #if CC_ENABLE_CACHE_TEXTURE_DATA
@@ -228,16 +450,25 @@ Renderer::Renderer()
 
 Renderer::~Renderer()
 {
+    delete _workers;
     _renderGroups.clear();
     _groupCommandManager->release();
     
-    glDeleteBuffers(2, _buffersVBO);
+    delete _vertexStream;
+    delete _indexStream;
+    delete _instanceStream;
+    TrianglesCommand::setInstanceableProgram(nullptr);
 
     free(_triBatchesToDraw);
 
     if (Configuration::getInstance()->supportsShareableVAO())
     {
         glDeleteVertexArrays(1, &_buffersVAO);
+        if (_instanceVAO)
+        {
+            glDeleteVertexArrays(1, &_instanceVAO);
+            glDeleteBuffers(1, &_cornerVBO);
+        }
         GL::bindVAO(0);
     }
 #if CC_ENABLE_CACHE_TEXTURE_DATA
@@ -263,91 +494,123 @@ void Renderer::initGLView()
 
 void Renderer::setupBuffer()
 {
-    if(Configuration::getInstance()->supportsShareableVAO())
+    auto conf = Configuration::getInstance();
+    if(conf->supportsShareableVAO())
     {
         setupVBOAndVAO();
+        if (conf->supportsInstancing() && conf->supportsMapBuffer())
+        {
+            setupInstancing();
+        }
     }
     else
     {
         setupVBO();
     }
+
+    setInstancing(_instancing);
 }
 
 void Renderer::setupVBOAndVAO()
 {
-    //generate vbo and vao for trianglesCommand
+    setupVBO();
+
+    //generate vao for trianglesCommand, the attributes point into the vertex stream at each draw
     glGenVertexArrays(1, &_buffersVAO);
     GL::bindVAO(_buffersVAO);
 
-    glGenBuffers(2, &_buffersVBO[0]);
-
-    glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-    // Issue #15652
-    // Should not initialize VBO with a large size (VBO_SIZE=65536),
-    // it may cause low FPS on some Android devices like LG G4 & Nexus 5X.
-    // It's probably because some implementations of OpenGLES driver will
-    // copy the whole memory of VBO which initialized at the first time
-    // once glBufferData/glBufferSubData is invoked.
-    // For more discussion, please refer to https://github.com/cocos2d/cocos2d-x/issues/15652
-    //glBufferData(GL_ARRAY_BUFFER, sizeof(_verts[0]) * VBO_SIZE, _verts, GL_DYNAMIC_DRAW);
-
-    // vertices
     glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_POSITION);
-    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid*) offsetof( V3F_C4B_T2F, vertices));
-
-    // colors
     glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_COLOR);
-    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(V3F_C4B_T2F), (GLvoid*) offsetof( V3F_C4B_T2F, colors));
-
-    // tex coords
     glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_TEX_COORD);
-    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid*) offsetof( V3F_C4B_T2F, texCoords));
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffersVBO[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_indices[0]) * INDEX_VBO_SIZE, _indices, GL_STATIC_DRAW);
+    GL::bindVAO(0);
+
+    CHECK_GL_ERROR_DEBUG();
+}
+
+void Renderer::setupInstancing()
+{
+#if CC_USE_INSTANCING
+    // the corners of the quad, as a strip
+    static const GLfloat corners[] = { 0, 0,  1, 0,  0, 1,  1, 1 };
+
+    // the attribute divisors need a VAO of their own
+    glGenVertexArrays(1, &_instanceVAO);
+    GL::bindVAO(_instanceVAO);
+
+    glGenBuffers(1, &_cornerVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, _cornerVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_TEX_COORD1);
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD1, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    // the others advance once per quad, they point into the instance stream at each draw
+    for (GLuint attrib : { GLProgram::VERTEX_ATTRIB_POSITION, GLProgram::VERTEX_ATTRIB_COLOR, GLProgram::VERTEX_ATTRIB_TEX_COORD, GLProgram::VERTEX_ATTRIB_TEX_COORD2 })
+    {
+        glEnableVertexAttribArray(attrib);
+        glVertexAttribDivisorARB(attrib, 1);
+    }
 
-    // Must unbind the VAO before changing the element buffer.
     GL::bindVAO(0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+    if (_instanceStream)
+        _instanceStream->recreate();
+    else
+        _instanceStream = new (std::nothrow) StreamBuffer(GL_ARRAY_BUFFER, sizeof(QuadInstance) * VBO_SIZE / 4);
+
     CHECK_GL_ERROR_DEBUG();
+#endif
 }
 
-void Renderer::setupVBO()
+void Renderer::setInstancing(bool enabled)
 {
-    glGenBuffers(2, &_buffersVBO[0]);
-    // Issue #15652
-    // Should not initialize VBO with a large size (VBO_SIZE=65536),
-    // it may cause low FPS on some Android devices like LG G4 & Nexus 5X.
-    // It's probably because some implementations of OpenGLES driver will
-    // copy the whole memory of VBO which initialized at the first time
-    // once glBufferData/glBufferSubData is invoked.
-    // For more discussion, please refer to https://github.com/cocos2d/cocos2d-x/issues/15652
-//    mapBuffers();
+    _instancing = enabled;
+    if (!enabled || !_instanceVAO)
+    {
+        _instanceProgram = nullptr;
+        TrianglesCommand::setInstanceableProgram(nullptr);
+        return;
+    }
+
+    auto cache = GLProgramCache::getInstance();
+    _instanceProgram = cache->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED);
+    TrianglesCommand::setInstanceableProgram(cache->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP));
 }
 
-void Renderer::mapBuffers()
+void Renderer::setupVBO()
 {
     // Avoid changing the element buffer for whatever VAO might be bound.
     GL::bindVAO(0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(_verts[0]) * VBO_SIZE, _verts, GL_DYNAMIC_DRAW);
-    
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffersVBO[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_indices[0]) * INDEX_VBO_SIZE, _indices, GL_STATIC_DRAW);
+    if (_vertexStream)
+    {
+        // the old buffers went away with the context
+        _vertexStream->recreate();
+        _indexStream->recreate();
+    }
+    else
+    {
+        _vertexStream = new (std::nothrow) StreamBuffer(GL_ARRAY_BUFFER, sizeof(V3F_C4B_T2F) * VBO_SIZE);
+        _indexStream = new (std::nothrow) StreamBuffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * INDEX_VBO_SIZE);
+    }
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     CHECK_GL_ERROR_DEBUG();
 }
 
 void Renderer::addCommand(RenderCommand* command)
 {
+    auto recorder = CommandRecorder::current();
+    if (recorder)
+    {
+        CCASSERT(command->getType() != RenderCommand::Type::UNKNOWN_COMMAND, "Invalid Command Type");
+        recorder->add(command);
+        return;
+    }
+
     int renderQueueID =_commandGroupStack.top();
     addCommand(command, renderQueueID);
 }
@@ -358,28 +621,55 @@ void Renderer::addCommand(RenderCommand* command, int renderQueueID)
     CCASSERT(renderQueueID >=0, "Invalid render queue");
     CCASSERT(command->getType() != RenderCommand::Type::UNKNOWN_COMMAND, "Invalid Command Type");
 
+    if (CommandRecorder::current())
+    {
+        std::lock_guard<std::mutex> lock(_renderGroupsMutex);
+        _renderGroups[renderQueueID].push_back(command);
+        return;
+    }
+
     _renderGroups[renderQueueID].push_back(command);
 }
 
 void Renderer::pushGroup(int renderQueueID)
 {
     CCASSERT(!_isRendering, "Cannot change render queue while rendering");
+    auto recorder = CommandRecorder::current();
+    if (recorder)
+    {
+        std::lock_guard<std::mutex> lock(_renderGroupsMutex);
+        recorder->pushGroup(&_renderGroups[renderQueueID]);
+        return;
+    }
     _commandGroupStack.push(renderQueueID);
 }
 
 void Renderer::popGroup()
 {
     CCASSERT(!_isRendering, "Cannot change render queue while rendering");
+    auto recorder = CommandRecorder::current();
+    if (recorder)
+    {
+        recorder->popGroup();
+        return;
+    }
     _commandGroupStack.pop();
 }
 
 int Renderer::createRenderQueue()
 {
+    std::lock_guard<std::mutex> lock(_renderGroupsMutex);
     RenderQueue newRenderQueue;
     _renderGroups.push_back(newRenderQueue);
     return (int)_renderGroups.size() - 1;
 }
 
+void Renderer::setWorkerThreads(unsigned count)
+{
+    delete _workers;
+    _workers = count ? new (std::nothrow) RenderWorkers(count) : nullptr;
+}
+
 void Renderer::processRenderCommand(RenderCommand* command)
 {
     auto commandType = command->getType();
@@ -390,14 +680,9 @@ void Renderer::processRenderCommand(RenderCommand* command)
 
         auto cmd = static_cast<TrianglesCommand*>(command);
         
-        // flush own queue when buffer is full
-        if(_filledVertex + cmd->getVertexCount() > VBO_SIZE || _filledIndex + cmd->getIndexCount() > INDEX_VBO_SIZE)
-        {
-            CCASSERT(cmd->getVertexCount()>= 0 && cmd->getVertexCount() < VBO_SIZE, "VBO for vertex is not big enough, please break the data down or use customized render command");
-            CCASSERT(cmd->getIndexCount()>= 0 && cmd->getIndexCount() < INDEX_VBO_SIZE, "VBO for index is not big enough, please break the data down or use customized render command");
-            drawBatchedTriangles();
-        }
-        
+        // the streams grow as needed, but one command's indices must reach all its vertices
+        CCASSERT(cmd->getVertexCount()>= 0 && cmd->getVertexCount() <= VBO_SIZE, "Too many vertices for 16-bit indices, please break the data down or use customized render command");
+
         // queue it
         _queuedTriangleCommands.push_back(cmd);
         _filledIndex += cmd->getIndexCount();
@@ -643,9 +928,19 @@ void Renderer::render()
         //1. Sort render commands based on ID
         for (auto &renderqueue : _renderGroups)
         {
-            renderqueue.sort();
+            // the queues of groups, like RenderTexture or ClippingNode, may be drawn with a projection of their own
+            bool reorder = _batchReordering && &renderqueue == &_renderGroups[0];
+            renderqueue.sort(reorder);
+            _batchesBeforeReorder += renderqueue.getBatchesBeforeReorder();
+            _batchesAfterReorder += renderqueue.getBatchesAfterReorder();
         }
         visitRenderQueue(_renderGroups[0]);
+
+        // what the next frames write must not touch what this one draws
+        _vertexStream->endFrame();
+        _indexStream->endFrame();
+        if (_instanceStream)
+            _instanceStream->endFrame();
     }
     clean();
     _isRendering = false;
@@ -668,6 +963,7 @@ void Renderer::clean()
     _queuedTriangleCommands.clear();
     _filledVertex = 0;
     _filledIndex = 0;
+    _filledInstance = 0;
     _lastBatchedMeshCommand = nullptr;
 }
 
@@ -706,26 +1002,88 @@ void Renderer::setDepthTest(bool enable)
     CHECK_GL_ERROR_DEBUG();
 }
 
-void Renderer::fillVerticesAndIndices(const TrianglesCommand* cmd)
+void Renderer::fillVerticesAndIndices(const TrianglesCommand* cmd, V3F_C4B_T2F* vertices, GLushort* indices, const TriangleOffsets& offsets)
 {
-    memcpy(&_verts[_filledVertex], cmd->getVertices(), sizeof(V3F_C4B_T2F) * cmd->getVertexCount());
-
     // fill vertex, and convert them to world coordinates
-    const Mat4& modelView = cmd->getModelView();
-    for(ssize_t i=0; i < cmd->getVertexCount(); ++i)
+    transformVertices(cmd->getModelView(), cmd->getVertices(), vertices + offsets.vertex, cmd->getVertexCount());
+
+    // fill index, relative to the segment
+    const unsigned short* src = cmd->getIndices();
+    const int first = offsets.vertex - offsets.base;
+    for(ssize_t i=0; i< cmd->getIndexCount(); ++i)
     {
-        modelView.transformPoint(&(_verts[i + _filledVertex].vertices));
+        indices[offsets.index + i] = first + src[i];
     }
+}
 
-    // fill index
-    const unsigned short* indices = cmd->getIndices();
-    for(ssize_t i=0; i< cmd->getIndexCount(); ++i)
+void Renderer::fillTriangles(V3F_C4B_T2F* vertices, GLushort* indices, void* instances)
+{
+    auto fill = [this, vertices, indices, instances] (size_t i) {
+        auto& offsets = _triangleOffsets[i];
+        if (offsets.instanced)
+            fillInstances(_queuedTriangleCommands[i], static_cast<QuadInstance*>(instances) + offsets.instance);
+        else
+            fillVerticesAndIndices(_queuedTriangleCommands[i], vertices, indices, offsets);
+    };
+
+    size_t count = _queuedTriangleCommands.size();
+    int work = _filledVertex + _filledInstance * INSTANCE_FILL_COST;
+    if (!_workers || work < PARALLEL_FILL_VERTICES || count < 2)
     {
-        _indices[_filledIndex + i] = _filledVertex + indices[i];
+        for (size_t i = 0; i < count; ++i)
+            fill(i);
+        return;
     }
 
-    _filledVertex += cmd->getVertexCount();
-    _filledIndex += cmd->getIndexCount();
+    // chunks of about the same work, found by the offsets
+    size_t chunks = std::min<size_t>(count, (_workers->getThreadCount() + 1) * FILL_CHUNKS_PER_THREAD);
+    auto first = [this, count, chunks, work] (size_t chunk) -> size_t {
+        if (chunk == chunks)
+            return count;
+        int target = (int)((int64_t)work * chunk / chunks);
+        auto it = std::lower_bound(_triangleOffsets.begin(), _triangleOffsets.end(), target,
+                                   [] (const TriangleOffsets& o, int w) { return o.vertex + o.instance * INSTANCE_FILL_COST < w; });
+        return it - _triangleOffsets.begin();
+    };
+
+    _workers->parallelFor(chunks, [&] (size_t chunk) {
+        for (size_t i = first(chunk), end = first(chunk + 1); i < end; ++i)
+            fill(i);
+    });
+}
+
+void Renderer::setVertexPointers(GLintptr offset)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexStream->getBuffer());
+
+    // vertices
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid*) (offset + offsetof(V3F_C4B_T2F, vertices)));
+
+    // colors
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(V3F_C4B_T2F), (GLvoid*) (offset + offsetof(V3F_C4B_T2F, colors)));
+
+    // tex coords
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid*) (offset + offsetof(V3F_C4B_T2F, texCoords)));
+}
+
+void Renderer::drawInstances(const TrianglesCommand* cmd, GLsizei count, GLintptr offset)
+{
+#if CC_USE_INSTANCING
+    GL::bindVAO(_instanceVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceStream->getBuffer());
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (GLvoid*) (offset + offsetof(QuadInstance, origin)));
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD2, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (GLvoid*) (offset + offsetof(QuadInstance, axisX)));
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(QuadInstance), (GLvoid*) (offset + offsetof(QuadInstance, color)));
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (GLvoid*) (offset + offsetof(QuadInstance, uvOrigin)));
+
+    // the material of the command, with the instanced program
+    GL::bindTexture2D(cmd->getTextureID());
+    GL::blendFunc(cmd->getBlendType().src, cmd->getBlendType().dst);
+    _instanceProgram->use();
+    _instanceProgram->setUniformsForBuiltins(cmd->getModelView());
+
+    glDrawArraysInstancedARB(GL_TRIANGLE_STRIP, 0, 4, count);
+#endif
 }
 
 void Renderer::drawBatchedTriangles()
@@ -737,29 +1095,57 @@ void Renderer::drawBatchedTriangles()
 
     _filledVertex = 0;
     _filledIndex = 0;
+    _filledInstance = 0;
 
     /************** 1: Setup up vertices/indices *************/
 
     _triBatchesToDraw[0].offset = 0;
     _triBatchesToDraw[0].indicesToDraw = 0;
     _triBatchesToDraw[0].cmd = nullptr;
+    _triBatchesToDraw[0].vertexBase = 0;
+    _triBatchesToDraw[0].instancesToDraw = 0;
+    _triBatchesToDraw[0].instanceOffset = 0;
 
     int batchesTotal = 0;
     int prevMaterialID = -1;
+    bool prevInstanced = false;
     bool firstCommand = true;
+    int segment = 0;
 
+    // where each command goes, the vertices are filled once the buffer is ready
+    _triangleOffsets.clear();
     for(const auto& cmd : _queuedTriangleCommands)
     {
         auto currentMaterialID = cmd->getMaterialID();
         const bool batchable = !cmd->isSkipBatching();
 
-        fillVerticesAndIndices(cmd);
+        // quads drawn as instances take no vertices nor indices
+        const bool instanced = _instanceProgram && cmd->isInstanceable();
+        const int indexCount = instanced ? 0 : (int) cmd->getIndexCount();
+        const int instanceCount = instanced ? (int) cmd->getQuadCount() : 0;
+
+        // 16-bit indices reach VBO_SIZE vertices from where their segment starts
+        const bool newSegment = !instanced && _filledVertex + cmd->getVertexCount() - segment > VBO_SIZE;
+        if (newSegment)
+            segment = _filledVertex;
+
+        _triangleOffsets.push_back(TriangleOffsets{_filledVertex, _filledIndex, segment, _filledInstance, instanced});
+        if (instanced)
+        {
+            _filledInstance += instanceCount;
+        }
+        else
+        {
+            _filledVertex += cmd->getVertexCount();
+            _filledIndex += indexCount;
+        }
 
         // in the same batch ?
-        if (batchable && (prevMaterialID == currentMaterialID || firstCommand))
+        if (batchable && !newSegment && (firstCommand || (prevMaterialID == currentMaterialID && prevInstanced == instanced)))
         {
             CC_ASSERT((firstCommand || _triBatchesToDraw[batchesTotal].cmd->getMaterialID() == cmd->getMaterialID()) && "argh... error in logic");
-            _triBatchesToDraw[batchesTotal].indicesToDraw += cmd->getIndexCount();
+            _triBatchesToDraw[batchesTotal].indicesToDraw += indexCount;
+            _triBatchesToDraw[batchesTotal].instancesToDraw += instanceCount;
             _triBatchesToDraw[batchesTotal].cmd = cmd;
         }
         else
@@ -768,10 +1154,13 @@ void Renderer::drawBatchedTriangles()
             if (!firstCommand) {
                 batchesTotal++;
                 _triBatchesToDraw[batchesTotal].offset = _triBatchesToDraw[batchesTotal-1].offset + _triBatchesToDraw[batchesTotal-1].indicesToDraw;
+                _triBatchesToDraw[batchesTotal].instanceOffset = _triBatchesToDraw[batchesTotal-1].instanceOffset + _triBatchesToDraw[batchesTotal-1].instancesToDraw;
             }
 
             _triBatchesToDraw[batchesTotal].cmd = cmd;
-            _triBatchesToDraw[batchesTotal].indicesToDraw = (int) cmd->getIndexCount();
+            _triBatchesToDraw[batchesTotal].indicesToDraw = indexCount;
+            _triBatchesToDraw[batchesTotal].instancesToDraw = instanceCount;
+            _triBatchesToDraw[batchesTotal].vertexBase = segment;
 
             // is this a single batch ? Prevent creating a batch group then
             if (!batchable)
@@ -785,74 +1174,72 @@ void Renderer::drawBatchedTriangles()
         }
 
         prevMaterialID = currentMaterialID;
+        prevInstanced = instanced;
         firstCommand = false;
     }
     batchesTotal++;
 
     /************** 2: Copy vertices/indices to GL objects *************/
     auto conf = Configuration::getInstance();
-    if (conf->supportsShareableVAO() && conf->supportsMapBuffer())
-    {
-        //Bind VAO
-        GL::bindVAO(_buffersVAO);
-        //Set VBO data
-        glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-
-        // option 1: subdata
-//        glBufferSubData(GL_ARRAY_BUFFER, sizeof(_quads[0])*start, sizeof(_quads[0]) * n , &_quads[start] );
-
-        // option 2: data
-//        glBufferData(GL_ARRAY_BUFFER, sizeof(_verts[0]) * _filledVertex, _verts, GL_STATIC_DRAW);
-
-        // option 3: orphaning + glMapBuffer
-        // FIXME: in order to work as fast as possible, it must "and the exact same size and usage hints it had before."
-        //  source: https://www.opengl.org/wiki/Buffer_Object_Streaming#Explicit_multiple_buffering
-        // so most probably we won't have any benefit of using it
-        glBufferData(GL_ARRAY_BUFFER, sizeof(_verts[0]) * _filledVertex, nullptr, GL_STATIC_DRAW);
-        void *buf = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-        memcpy(buf, _verts, sizeof(_verts[0]) * _filledVertex);
-        glUnmapBuffer(GL_ARRAY_BUFFER);
-
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffersVBO[1]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_indices[0]) * _filledIndex, _indices, GL_STATIC_DRAW);
-    }
-    else
-    {
-        // Client Side Arrays
-#define kQuadSize sizeof(_verts[0])
-        glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(_verts[0]) * _filledVertex , _verts, GL_DYNAMIC_DRAW);
+    const bool useVAO = conf->supportsShareableVAO() && conf->supportsMapBuffer();
 
+    // the element buffer binding belongs to the bound VAO
+    GL::bindVAO(useVAO ? _buffersVAO : 0);
+    if (!useVAO)
         GL::enableVertexAttribs(GL::VERTEX_ATTRIB_FLAG_POS_COLOR_TEX);
 
-        // vertices
-        glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, kQuadSize, (GLvoid*) offsetof(V3F_C4B_T2F, vertices));
-
-        // colors
-        glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, kQuadSize, (GLvoid*) offsetof(V3F_C4B_T2F, colors));
-
-        // tex coords
-        glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, kQuadSize, (GLvoid*) offsetof(V3F_C4B_T2F, texCoords));
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffersVBO[1]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_indices[0]) * _filledIndex, _indices, GL_STATIC_DRAW);
-    }
+    // transformed straight into the streams, appended to the batches drawn before
+    GLintptr vertexOffset = 0, indexOffset = 0, instanceOffset = 0;
+    V3F_C4B_T2F* vertices = nullptr;
+    GLushort* indices = nullptr;
+    void* instances = nullptr;
+    if (_filledVertex)
+        vertices = static_cast<V3F_C4B_T2F*>(_vertexStream->map(sizeof(V3F_C4B_T2F) * _filledVertex, &vertexOffset));
+    if (_filledIndex)
+        indices = static_cast<GLushort*>(_indexStream->map(sizeof(GLushort) * _filledIndex, &indexOffset));
+    if (_filledInstance)
+        instances = _instanceStream->map(sizeof(QuadInstance) * _filledInstance, &instanceOffset);
+
+    fillTriangles(vertices, indices, instances);
+
+    if (_filledVertex)
+        _vertexStream->unmap();
+    if (_filledIndex)
+        _indexStream->unmap();
+    if (_filledInstance)
+        _instanceStream->unmap();
 
     /************** 3: Draw *************/
+    int vertexBase = -1;
     for (int i=0; i<batchesTotal; ++i)
     {
-        CC_ASSERT(_triBatchesToDraw[i].cmd && "Invalid batch");
-        _triBatchesToDraw[i].cmd->useMaterial();
-        glDrawElements(GL_TRIANGLES, (GLsizei) _triBatchesToDraw[i].indicesToDraw, GL_UNSIGNED_SHORT, (GLvoid*) (_triBatchesToDraw[i].offset*sizeof(_indices[0])) );
+        auto& batch = _triBatchesToDraw[i];
+        CC_ASSERT(batch.cmd && "Invalid batch");
+        if (batch.instancesToDraw)
+        {
+            drawInstances(batch.cmd, batch.instancesToDraw, instanceOffset + sizeof(QuadInstance) * batch.instanceOffset);
+            _drawnBatches++;
+            _drawnVertices += batch.instancesToDraw * 6;
+            continue;
+        }
+        if (!batch.indicesToDraw)
+            continue;
+
+        if (useVAO)
+            GL::bindVAO(_buffersVAO);
+        if (batch.vertexBase != vertexBase)
+        {
+            vertexBase = batch.vertexBase;
+            setVertexPointers(vertexOffset + sizeof(V3F_C4B_T2F) * vertexBase);
+        }
+        batch.cmd->useMaterial();
+        glDrawElements(GL_TRIANGLES, (GLsizei) batch.indicesToDraw, GL_UNSIGNED_SHORT, (GLvoid*) (indexOffset + batch.offset*sizeof(GLushort)) );
         _drawnBatches++;
-        _drawnVertices += _triBatchesToDraw[i].indicesToDraw;
+        _drawnVertices += batch.indicesToDraw;
     }
 
     /************** 4: Cleanup *************/
-    if (conf->supportsShareableVAO() && conf->supportsMapBuffer())
+    if (useVAO)
     {
         //Unbind VAO
         GL::bindVAO(0);
@@ -866,6 +1253,7 @@ void Renderer::drawBatchedTriangles()
     _queuedTriangleCommands.clear();
     _filledVertex = 0;
     _filledIndex = 0;
+    _filledInstance = 0;
 }
 
 void Renderer::flush()
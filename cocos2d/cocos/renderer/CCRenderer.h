@@ -27,6 +27,8 @@
 #ifndef __CC_RENDERER_H_
 #define __CC_RENDERER_H_
 
+#include <deque>
+#include <mutex>
 #include <vector>
 #include <stack>
 
@@ -95,8 +97,10 @@ public:
     void push_back(RenderCommand* command);
     /**Return the number of render commands.*/
     ssize_t size() const;
-    /**Sort the render commands.*/
-    void sort();
+    /**Sort the render commands. With `reorderBatches`, TrianglesCommands of the 2D groups that don't overlap on screen
+     are also moved next to commands of the same material, so that more of them are drawn in a batch. The screen is
+     the one of the projection loaded when sorting, so only a queue drawn with it may be reordered.*/
+    void sort(bool reorderBatches = false);
     /**Treat sorted commands as an array, access them one by one.*/
     RenderCommand* operator[](ssize_t index) const;
     /**Clear all rendered commands.*/
@@ -112,8 +116,30 @@ public:
     void saveRenderState();
     /**Restore the saved DepthState, CullState, DepthWriteState render state.*/
     void restoreRenderState();
+
+    /**The number of triangle batches the last sort found before reordering.*/
+    ssize_t getBatchesBeforeReorder() const { return _batchesBeforeReorder; }
+    /**The number of triangle batches left after reordering.*/
+    ssize_t getBatchesAfterReorder() const { return _batchesAfterReorder; }
     
 protected:
+    // a command as reorderBatches() sees it
+    struct ReorderItem
+    {
+        RenderCommand* cmd;
+        int64_t key;        // batches with the previous item of the same key, -1 never
+        bool movable;
+        bool triangles;
+        Vec2 min, max;      // screen bounds in normalized device coordinates
+
+        bool overlaps(const ReorderItem& other) const;
+        // sets the bounds of the command's triangles on screen, false if some reach behind the camera
+        bool bound(const TrianglesCommand* command, const Mat4& projection);
+    };
+
+    void reorderBatches(std::vector<RenderCommand*>& commands, const Mat4& projection);
+    ssize_t countReorderedBatches() const;
+
     /**The commands in the render queue.*/
     std::vector<RenderCommand*> _commands[QUEUE_COUNT];
     
@@ -123,6 +149,11 @@ protected:
     bool _isDepthEnabled;
     /**Depth buffer write state.*/
     GLboolean _isDepthWrite;
+
+    ssize_t _batchesBeforeReorder;
+    ssize_t _batchesAfterReorder;
+    // reused by reorderBatches()
+    std::vector<ReorderItem> _reorderItems;
 };
 
 //the struct is not used outside.
@@ -133,6 +164,9 @@ struct RenderStackElement
 };
 
 class GroupCommandManager;
+class RenderWorkers;
+class StreamBuffer;
+class GLProgram;
 
 /* Class responsible for the rendering in.
 
@@ -141,9 +175,9 @@ Whenever possible prefer to use `TrianglesCommand` objects since the renderer wi
 class CC_DLL Renderer
 {
 public:
-    /**The max number of vertices in a vertex buffer object.*/
+    /**The max number of vertices one draw of batched triangles addresses with 16-bit indices.*/
     static const int VBO_SIZE = 65536;
-    /**The max number of indices in a index buffer.*/
+    /**The number of indices the index buffer starts with room for each frame.*/
     static const int INDEX_VBO_SIZE = VBO_SIZE * 6 / 4;
     /**The rendercommands which can be batched will be saved into a list, this is the reserved size of this list.*/
     static const int BATCH_TRIAGCOMMAND_RESERVED_SIZE = 64;
@@ -193,8 +227,12 @@ public:
     ssize_t getDrawnVertices() const { return _drawnVertices; }
     /* RenderCommands (except) TrianglesCommand should update this value */
     void addDrawnVertices(ssize_t number) { _drawnVertices += number; };
+    /* returns the number of triangle batches the render queues had before reordering in the last frame, see setBatchReordering() */
+    ssize_t getBatchesBeforeReorder() const { return _batchesBeforeReorder; }
+    /* returns the number of triangle batches left after reordering in the last frame */
+    ssize_t getBatchesAfterReorder() const { return _batchesAfterReorder; }
     /* clear draw stats */
-    void clearDrawStats() { _drawnBatches = _drawnVertices = 0; }
+    void clearDrawStats() { _drawnBatches = _drawnVertices = _batchesBeforeReorder = _batchesAfterReorder = 0; }
 
     /**
      * Enable/Disable depth test
@@ -209,14 +247,38 @@ public:
     /** returns whether or not a rectangle is visible or not */
     bool checkVisibility(const Mat4& transform, const Size& size);
 
+    /** Starts `count` render worker threads, or stops them with 0 (the default).
+     Nodes whose children are visited in parallel use them, see Node::setVisitChildrenInParallel(),
+     and so do large triangle batches to fill their vertices. Call it between frames. */
+    void setWorkerThreads(unsigned count);
+    /** The render workers, nullptr when there are none. */
+    RenderWorkers* getWorkers() const { return _workers; }
+
+    /** Draws the quads of SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP as instances, see TrianglesCommand::isInstanceable(),
+     instead of transforming their vertices on the CPU. On by default where CC_USE_INSTANCING and the GPU support it. */
+    void setInstancing(bool enabled);
+    /** Whether quads are drawn as instances. */
+    bool isInstancing() const { return _instanceProgram != nullptr; }
+
+    /** Lets the camera's render queue move 2D TrianglesCommands that don't overlap on screen next to commands of the
+     same material while sorting, to draw fewer batches, see RenderQueue::sort(). The queues of groups keep their
+     order, they may be drawn with another projection. Off by default. */
+    void setBatchReordering(bool enabled) { _batchReordering = enabled; }
+    /** Whether the render queues reorder commands to batch them. */
+    bool isBatchReordering() const { return _batchReordering; }
+
 protected:
 
     //Setup VBO or VAO based on OpenGL extensions
     void setupBuffer();
     void setupVBOAndVAO();
     void setupVBO();
-    void mapBuffers();
+    void setupInstancing();
     void drawBatchedTriangles();
+    // points the vertex attributes at the streamed vertices from `offset` on
+    void setVertexPointers(GLintptr offset);
+    // draws the quads of an instanced batch, from `offset` in the instance stream
+    void drawInstances(const TrianglesCommand* cmd, GLsizei count, GLintptr offset);
 
     //Draw the previews queued triangles and flush previous context
     void flush();
@@ -230,7 +292,10 @@ protected:
     void processRenderCommand(RenderCommand* command);
     void visitRenderQueue(RenderQueue& queue);
 
-    void fillVerticesAndIndices(const TrianglesCommand* cmd);
+    struct TriangleOffsets;
+    void fillVerticesAndIndices(const TrianglesCommand* cmd, V3F_C4B_T2F* vertices, GLushort* indices, const TriangleOffsets& offsets);
+    // fills the queued triangles into vertices and indices, or instances, on the render workers if there are
+    void fillTriangles(V3F_C4B_T2F* vertices, GLushort* indices, void* instances);
 
 
     /* clear color set outside be used in setGLDefaultValues() */
@@ -238,22 +303,47 @@ protected:
 
     std::stack<int> _commandGroupStack;
     
-    std::vector<RenderQueue> _renderGroups;
+    // a deque keeps the queues in place while render workers create more
+    std::deque<RenderQueue> _renderGroups;
+    std::mutex _renderGroupsMutex;
+    RenderWorkers* _workers;
 
     MeshCommand* _lastBatchedMeshCommand;
     std::vector<TrianglesCommand*> _queuedTriangleCommands;
 
+    // where the vertices and indices of each queued TrianglesCommand go
+    struct TriangleOffsets
+    {
+        int vertex;
+        int index;
+        int base;   // first vertex of the segment its indices are relative to
+        int instance;
+        bool instanced;
+    };
+    std::vector<TriangleOffsets> _triangleOffsets;
+
     //for TrianglesCommand
-    V3F_C4B_T2F _verts[VBO_SIZE];
-    GLushort _indices[INDEX_VBO_SIZE];
     GLuint _buffersVAO;
-    GLuint _buffersVBO[2]; //0: vertex  1: indices
+    StreamBuffer* _vertexStream;
+    StreamBuffer* _indexStream;
+
+    //for instanced quads
+    GLuint _instanceVAO;
+    GLuint _cornerVBO;
+    StreamBuffer* _instanceStream;
+    GLProgram* _instanceProgram;
+    bool _instancing;
+
+    bool _batchReordering;
 
     // Internal structure that has the information for the batches
     struct TriBatchToDraw {
         TrianglesCommand* cmd;  // needed for the Material
         GLsizei indicesToDraw;
         GLsizei offset;
+        int vertexBase;         // first vertex of its segment
+        GLsizei instancesToDraw;    // instead of indices for instanced quads
+        GLsizei instanceOffset;
     };
     // capacity of the array of TriBatches
     int _triBatchesToDrawCapacity;
@@ -262,12 +352,15 @@ protected:
 
     int _filledVertex;
     int _filledIndex;
+    int _filledInstance;
 
     bool _glViewAssigned;
 
     // stats
     ssize_t _drawnBatches;
     ssize_t _drawnVertices;
+    ssize_t _batchesBeforeReorder;
+    ssize_t _batchesAfterReorder;
     //the flag for checking whether renderer is rendering
     bool _isRendering;
     
@@ -0,0 +1,255 @@
+/****************************************************************************
+ Copyright (c) 2017-2018 Xiamen Yaji Software Co., Ltd.
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+
+
+#include "renderer/CCStreamBuffer.h"
+#include "base/CCConfiguration.h"
+#include "base/ccMacros.h"
+
+NS_CC_BEGIN
+
+namespace
+{
+    const GLsizeiptr ALIGNMENT = 16;
+
+    GLsizeiptr alignUp(GLsizeiptr size)
+    {
+        return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+}
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr regionSize)
+: _target(target)
+, _mode(Mode::ORPHAN)
+, _buffer(0)
+, _regionSize(0)
+, _region(0)
+, _head(0)
+, _waited(false)
+, _persistent(nullptr)
+, _mapped(nullptr)
+, _staged(false)
+, _mappedOffset(0)
+, _mappedSize(0)
+{
+#if CC_STREAM_BUFFER_MAP_RANGE
+    for (auto& fence : _fences)
+        fence = nullptr;
+#endif
+    auto conf = Configuration::getInstance();
+    if (conf->supportsBufferStorage())
+        _mode = Mode::PERSISTENT;
+    else if (conf->supportsMapBufferRange())
+        _mode = Mode::UNSYNCHRONIZED;
+
+    allocate(alignUp(regionSize));
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    release();
+}
+
+void StreamBuffer::allocate(GLsizeiptr regionSize)
+{
+    release();
+    _regionSize = regionSize;
+    _region = 0;
+    _head = 0;
+    _waited = false;
+
+    glGenBuffers(1, &_buffer);
+    // ORPHAN buffers are sized by each write
+    if (_mode == Mode::ORPHAN)
+        return;
+
+#if CC_STREAM_BUFFER_MAP_RANGE
+    GLsizeiptr size = _regionSize * REGIONS;
+    glBindBuffer(_target, _buffer);
+#ifdef GL_ARB_buffer_storage
+    if (_mode == Mode::PERSISTENT)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(_target, size, nullptr, flags);
+        _persistent = glMapBufferRange(_target, 0, size, flags);
+        if (!_persistent)
+        {
+            CCLOG("cocos2d: StreamBuffer: can't map the buffer persistently, mapping each write instead");
+            _mode = Mode::UNSYNCHRONIZED;
+            // storage is immutable, start over with a new buffer
+            glDeleteBuffers(1, &_buffer);
+            glGenBuffers(1, &_buffer);
+            glBindBuffer(_target, _buffer);
+        }
+    }
+#endif
+    if (_mode == Mode::UNSYNCHRONIZED)
+    {
+        glBufferData(_target, size, nullptr, GL_STREAM_DRAW);
+    }
+    CHECK_GL_ERROR_DEBUG();
+#endif
+}
+
+void StreamBuffer::release()
+{
+#if CC_STREAM_BUFFER_MAP_RANGE
+    for (auto& fence : _fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+#endif
+    // deleting the buffer unmaps it too
+    if (_buffer)
+        glDeleteBuffers(1, &_buffer);
+    _buffer = 0;
+    _persistent = nullptr;
+    _mapped = nullptr;
+}
+
+void StreamBuffer::recreate()
+{
+#if CC_STREAM_BUFFER_MAP_RANGE
+    for (auto& fence : _fences)
+        fence = nullptr;
+#endif
+    _buffer = 0;
+    _persistent = nullptr;
+    _mapped = nullptr;
+    allocate(_regionSize);
+}
+
+void* StreamBuffer::map(GLsizeiptr size, GLintptr* offset)
+{
+    CCASSERT(!_mapped, "StreamBuffer: unmap() the previous write first");
+    CCASSERT(size > 0, "StreamBuffer: nothing to write");
+
+    glBindBuffer(_target, _buffer);
+    _mappedOffset = 0;
+    _mappedSize = size;
+    _staged = false;
+
+    if (_mode == Mode::ORPHAN)
+    {
+        if (Configuration::getInstance()->supportsMapBuffer())
+        {
+            glBufferData(_target, size, nullptr, GL_DYNAMIC_DRAW);
+            _mapped = glMapBuffer(_target, GL_WRITE_ONLY);
+        }
+    }
+#if CC_STREAM_BUFFER_MAP_RANGE
+    else
+    {
+        GLintptr start = alignUp(_head);
+        if (start + size > _regionSize)
+        {
+            // the frame outgrew its region: start over with larger ones, the
+            // draws issued so far keep reading the old storage
+            GLsizeiptr regionSize = _regionSize * 2;
+            while (regionSize < size)
+                regionSize *= 2;
+            allocate(regionSize);
+            start = 0;
+        }
+        if (!_waited)
+        {
+            wait(_region);
+            _waited = true;
+        }
+
+        _head = start + size;
+        _mappedOffset = _region * _regionSize + start;
+        if (_mode == Mode::PERSISTENT)
+            _mapped = static_cast<char*>(_persistent) + _mappedOffset;
+        else
+            _mapped = glMapBufferRange(_target, _mappedOffset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+#endif
+
+    if (!_mapped)
+    {
+        _staging.resize(size);
+        _mapped = _staging.data();
+        _staged = true;
+    }
+    *offset = _mappedOffset;
+    return _mapped;
+}
+
+void StreamBuffer::unmap()
+{
+    if (!_mapped)
+        return;
+
+    glBindBuffer(_target, _buffer);
+    if (_staged)
+    {
+        if (_mode == Mode::ORPHAN)
+            glBufferData(_target, _mappedSize, _mapped, GL_DYNAMIC_DRAW);
+        else
+            glBufferSubData(_target, _mappedOffset, _mappedSize, _mapped);
+    }
+    else if (_mode != Mode::PERSISTENT)
+    {
+        glUnmapBuffer(_target);
+    }
+    _mapped = nullptr;
+}
+
+void StreamBuffer::endFrame()
+{
+    if (_mode == Mode::ORPHAN || !_head)
+        return;
+
+#if CC_STREAM_BUFFER_MAP_RANGE
+    _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+    _region = (_region + 1) % REGIONS;
+    _head = 0;
+    _waited = false;
+}
+
+void StreamBuffer::wait(int region)
+{
+#if CC_STREAM_BUFFER_MAP_RANGE
+    GLsync fence = _fences[region];
+    if (!fence)
+        return;
+
+    // only blocks when the GPU is REGIONS frames behind
+    GLenum status;
+    do
+    {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    } while (status == GL_TIMEOUT_EXPIRED);
+
+    glDeleteSync(fence);
+    _fences[region] = nullptr;
+#endif
+}
+
+NS_CC_END
@@ -0,0 +1,123 @@
+/****************************************************************************
+ Copyright (c) 2017-2018 Xiamen Yaji Software Co., Ltd.
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+
+#ifndef __CC_STREAM_BUFFER_H_
+#define __CC_STREAM_BUFFER_H_
+
+#include <vector>
+
+#include "platform/CCPlatformMacros.h"
+#include "platform/CCGL.h"
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+// glMapBufferRange() and fences are only declared where GLEW loads them
+#if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32 || CC_TARGET_PLATFORM == CC_PLATFORM_LINUX)
+#define CC_STREAM_BUFFER_MAP_RANGE 1
+#else
+#define CC_STREAM_BUFFER_MAP_RANGE 0
+#endif
+
+NS_CC_BEGIN
+
+/**
+ Buffer object the renderer streams its batches through. It is a ring of
+ REGIONS regions: everything written between two endFrame() calls goes to
+ one region, which is fenced and not written again until the GPU is done
+ with it, so writes never wait for the draws of the previous frames and
+ batches of one frame append to each other. A region grows when a frame
+ doesn't fit in it.
+
+ The buffer stays mapped where glBufferStorage() is supported, and is mapped
+ unsynchronized for each write where only glMapBufferRange() is. Elsewhere
+ each write replaces the whole buffer as before, since sub-data uploads into
+ a large buffer are slow on some OpenGL ES drivers (issue #15652).
+ */
+class CC_DLL StreamBuffer
+{
+public:
+    enum class Mode
+    {
+        PERSISTENT,
+        UNSYNCHRONIZED,
+        ORPHAN,
+    };
+
+    static const int REGIONS = 3;
+
+    /** Creates the buffer for `target`, with regions of `regionSize` bytes. */
+    StreamBuffer(GLenum target, GLsizeiptr regionSize);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    GLuint getBuffer() const { return _buffer; }
+    Mode getMode() const { return _mode; }
+
+    /** Binds the buffer and returns where to write `size` bytes; `offset` receives
+     their offset in the buffer. The memory may be written from any thread until unmap(). */
+    void* map(GLsizeiptr size, GLintptr* offset);
+    /** Hands the bytes written since map() to GL. */
+    void unmap();
+    /** Fences what was written since the last call and moves on to the next region. */
+    void endFrame();
+    /** Creates new GL objects after the context was lost, forgetting the old ones. */
+    void recreate();
+
+private:
+    void allocate(GLsizeiptr regionSize);
+    void release();
+    void wait(int region);
+
+    GLenum _target;
+    Mode _mode;
+    GLuint _buffer;
+    GLsizeiptr _regionSize;
+    int _region;
+    GLintptr _head;         // bytes used in the current region
+    bool _waited;           // the current region is free to write
+
+    void* _persistent;      // the whole buffer in PERSISTENT mode
+    void* _mapped;
+    bool _staged;           // _mapped points to _staging
+    GLintptr _mappedOffset;
+    GLsizeiptr _mappedSize;
+    std::vector<char> _staging;
+#if CC_STREAM_BUFFER_MAP_RANGE
+    GLsync _fences[REGIONS];
+#endif
+};
+
+NS_CC_END
+
+/**
+ end of support group
+ @}
+ */
+#endif //__CC_STREAM_BUFFER_H_
@@ -33,12 +33,39 @@
 
 NS_CC_BEGIN
 
+GLProgram* TrianglesCommand::__instanceableProgram = nullptr;
+
+namespace
+{
+    const unsigned short QUAD_INDICES[] = { 0, 1, 2, 3, 2, 1 };
+
+    // v holds tl, bl, tr, br as in V3F_C4B_T2F_Quad
+    bool isInstanceableQuad(const V3F_C4B_T2F* v)
+    {
+        // quads rotated on the CPU, like particles, are rounded
+        const float EPSILON = 0.01f;
+        const auto& tl = v[0];
+        const auto& bl = v[1];
+        const auto& tr = v[2];
+        const auto& br = v[3];
+
+        return bl.colors == tl.colors && bl.colors == tr.colors && bl.colors == br.colors
+            && bl.texCoords.u == tl.texCoords.u && br.texCoords.u == tr.texCoords.u
+            && bl.texCoords.v == br.texCoords.v && tl.texCoords.v == tr.texCoords.v
+            && bl.vertices.z == tl.vertices.z && bl.vertices.z == tr.vertices.z && bl.vertices.z == br.vertices.z
+            && std::abs(tr.vertices.x - (br.vertices.x + tl.vertices.x - bl.vertices.x)) <= EPSILON
+            && std::abs(tr.vertices.y - (br.vertices.y + tl.vertices.y - bl.vertices.y)) <= EPSILON;
+    }
+}
+
 TrianglesCommand::TrianglesCommand()
 :_materialID(0)
 ,_textureID(0)
 ,_glProgramState(nullptr)
 ,_blendType(BlendFunc::DISABLE)
 ,_alphaTextureID(0)
+,_quadCount(0)
+,_instanceable(false)
 {
     _type = RenderCommand::Type::TRIANGLES_COMMAND;
 }
@@ -68,6 +95,16 @@ void TrianglesCommand::init(float globalOrder, GLuint textureID, GLProgramState*
 
         generateMaterialID();
     }
+
+    if (_triangles.vertCount == 4 && _triangles.indexCount == 6 && memcmp(_triangles.indices, QUAD_INDICES, sizeof(QUAD_INDICES)) == 0)
+    {
+        checkQuads(1);
+    }
+    else
+    {
+        _quadCount = 0;
+        _instanceable = false;
+    }
 }
 
 void TrianglesCommand::init(float globalOrder, GLuint textureID, GLProgramState* glProgramState, BlendFunc blendType, const Triangles& triangles,const Mat4& mv)
@@ -113,6 +150,29 @@ void TrianglesCommand::generateMaterialID()
     _materialID = XXH32((const void*)&hashMe, sizeof(hashMe), 0);
 }
 
+void TrianglesCommand::checkQuads(ssize_t quadCount)
+{
+    _quadCount = quadCount;
+    _instanceable = false;
+    if (!__instanceableProgram || _glProgramState->getGLProgram() != __instanceableProgram)
+        return;
+    // the instanced program can't take uniforms set on the state
+    if (_glProgramState->getUniformCount() > 0)
+        return;
+
+    // one depth per quad, no perspective
+    const float* m = _mv.m;
+    if (m[2] != 0 || m[6] != 0 || m[3] != 0 || m[7] != 0 || m[11] != 0 || m[15] != 1)
+        return;
+
+    for (ssize_t i = 0; i < quadCount; ++i)
+    {
+        if (!isInstanceableQuad(_triangles.verts + i * 4))
+            return;
+    }
+    _instanceable = true;
+}
+
 void TrianglesCommand::useMaterial() const
 {
     //Set texture
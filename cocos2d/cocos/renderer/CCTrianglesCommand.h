@@ -95,10 +95,20 @@ public:
     BlendFunc getBlendType() const { return _blendType; }
     /**Get the model view matrix.*/
     const Mat4& getModelView() const { return _mv; }
+    /**Get the number of quads when the triangles are quads laid out as in QuadCommand, 0 otherwise.*/
+    ssize_t getQuadCount() const { return _quadCount; }
+    /**Whether the quads can be drawn as instances: they use the instanceable program with no uniforms set on their state, each one is a
+     parallelogram with one color and an axis-aligned texture rect, and the model view is a 2D affine transform.*/
+    bool isInstanceable() const { return _instanceable; }
+
+    /**Quads using `program` are checked for instancing, none with nullptr. Set by Renderer::setInstancing().*/
+    static void setInstanceableProgram(GLProgram* program) { __instanceableProgram = program; }
     
 protected:
     /**Generate the material ID by textureID, glProgramState, and blend function.*/
     void generateMaterialID();
+    /**Set the quad count and check whether the quads are instanceable.*/
+    void checkQuads(ssize_t quadCount);
     
     /**Generated material id.*/
     uint32_t _materialID;
@@ -114,6 +124,11 @@ protected:
     Mat4 _mv;
 
     GLuint _alphaTextureID; // ANDROID ETC1 ALPHA supports.
+
+    ssize_t _quadCount;
+    bool _instanceable;
+
+    static GLProgram* __instanceableProgram;
 };
 
 NS_CC_END
@@ -0,0 +1,48 @@
+/****************************************************************************
+ Copyright (c) 2017-2018 Xiamen Yaji Software Co., Ltd.
+
+ http://www.cocos2d-x.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ ****************************************************************************/
+
+const char* ccPositionTextureColor_instanced_vert = R"(
+// one instance per quad, see Renderer::QuadInstance
+attribute vec2 a_texCoord1;     // corner of the quad, (0, 0) to (1, 1)
+attribute vec4 a_position;      // bottom left corner
+attribute vec4 a_texCoord2;     // bottom edge in xy, left edge in zw
+attribute vec4 a_color;
+attribute vec4 a_texCoord;      // texture rect, bottom left in xy, top right in zw
+
+#ifdef GL_ES
+varying lowp vec4 v_fragmentColor;
+varying mediump vec2 v_texCoord;
+#else
+varying vec4 v_fragmentColor;
+varying vec2 v_texCoord;
+#endif
+
+void main()
+{
+    vec2 position = a_position.xy + a_texCoord2.xy * a_texCoord1.x + a_texCoord2.zw * a_texCoord1.y;
+    gl_Position = CC_PMatrix * vec4(position, a_position.z, 1.0);
+    v_fragmentColor = a_color;
+    v_texCoord = mix(a_texCoord.xy, a_texCoord.zw, a_texCoord1);
+}
+)";